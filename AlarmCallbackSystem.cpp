@@ -1,63 +1,131 @@
 // How do u design a alarm callback system? It can take a callback function and a time after which to call this function.
 //  Your system has to keep track of everything and do this in a timely and performant manner. 
 
-struct Alarm{
-    std::function<void> cb;
-    int callback_time;
-    int pushed_time;
-};
+// g++ -std=c++20 -O2 -pthread AlarmCallbackSystem.cpp
+//   ./a.out        → callbacks pushed out of order fire by due time, then 3 coroutines
+//                    co_await alarms.delay() in a loop without holding a thread
 
-class ThreadPool{
+#include <iostream>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <iomanip>
 
-};
+// First attempt, kept as notes: std::function<void> needs to be std::function<void()>,
+// current_time is never defined, and a FIFO queue can't tell which alarm is due first.
+
+// struct Alarm{
+//     std::function<void> cb;
+//     int callback_time;
+//     int pushed_time;
+// };
+
+// class ThreadPool{
+
+// };
+
+
+// class AlarmCallbackSystem{
+
+//     std::queue<Alarm> callback_registry;
+//     std::mutex mtx;
+//     std::condition_variable cv;
+//     ThreadPool threadPool;
+//     std::thread alarm_thread;
+
+//     void loop(){
+//         while(true){
+//             {
+//                 std::unique_lock<std::mutex> lock(mtx);
+//                 cv.wait(lock, [](){
+//                     return !callback_registry.empty();
+//                 });
+
+//                 while(!callback_registry.empty()){
+//                     std::function<void> cb;
+//                     Alarm item = callback_registry.front();
+
+//                     if(item.pushed - current_time > callback_time){
+//                         callback_registry.pop();
+//                         threadPool.enqueue(std::move(item.cb));
+//                     }
+//                 }
+//             }
+//         }
+//     }
+// public:
+//     AlarmCallbackSystem(){
+//         alarm_thread = std::thread(loop);
+//     }
 
+//     void pushEvent(std::function<void> cb, int callback_time){
+//         {
+//             int current_time = 1;
+//             std::unique_lock<std::mutex> lock(mtx);
 
-class AlarmCallbackSystem{
+//             Alarm alarm(cb, callback_time,current_time);
+//             callback_registry.push(alarm);
+//         }
 
-    std::queue<Alarm> callback_registry;
+//         cv.notify_one();
+//     }
+
+
+// };
+
+
+// Minimal pool for the due callbacks: workers pop under the lock and run outside it,
+// the destructor runs what is still queued, then joins.
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
     std::mutex mtx;
     std::condition_variable cv;
-    ThreadPool threadPool;
-    std::thread alarm_thread;
+    bool stopping = false;
 
-    void loop(){
-        while(true){
-            {
-                std::unique_lock<std::mutex> lock(mtx);
-                cv.wait(lock, [](){
-                    return !callback_registry.empty();
-                });
-
-                while(!callback_registry.empty()){
-                    std::function<void> cb;
-                    Alarm item = callback_registry.front();
-
-                    if(item.pushed - current_time > callback_time){
-                        callback_registry.pop();
-                        threadPool.enqueue(std::move(item.cb));
+public:
+    explicit ThreadPool(size_t threads = 2) {
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back([this] {
+                while (true) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(mtx);
+                        cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                        if (tasks.empty()) return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
                     }
+                    task();
                 }
-            }
+            });
         }
     }
-public:
-    AlarmCallbackSystem(){
-        alarm_thread = std::thread(loop);
-    }
 
-    void pushEvent(std::function<void> cb, int callback_time){
+    void enqueue(std::function<void()> task) {
         {
-            int current_time = 1;
-            std::unique_lock<std::mutex> lock(mtx);
-
-            Alarm alarm(cb, callback_time,current_time);
-            callback_registry.push(alarm);
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push(std::move(task));
         }
-
         cv.notify_one();
     }
 
-
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
 };
 
 
@@ -114,6 +182,22 @@ public:
         cv.notify_one();
     }
 
+    // Coroutine version of a delayed callback: `co_await alarms.delay(100ms);`
+    // Nothing blocks while waiting, the coroutine is resumed from threadPool when the alarm fires.
+    auto delay(std::chrono::milliseconds delay) {
+        struct DelayAwaiter {
+            AlarmCallbackSystem& alarms;
+            std::chrono::milliseconds delay;
+
+            bool await_ready() const noexcept { return delay.count() <= 0; }
+            void await_suspend(std::coroutine_handle<> handle) {
+                alarms.pushEvent([handle] { handle.resume(); }, delay);
+            }
+            void await_resume() const noexcept {}
+        };
+        return DelayAwaiter{*this, delay};
+    }
+
     void shutdown() {
         {
             std::lock_guard<std::mutex> lock(mtx);
@@ -122,4 +206,55 @@ public:
         cv.notify_all();
         if (alarm_thread.joinable()) alarm_thread.join();
     }
+
+    ~AlarmCallbackSystem() {
+        shutdown();
+    }
 };
+
+// Fire-and-forget coroutine: starts right away, frees its frame when it finishes
+struct DetachedCoroutine {
+    struct promise_type {
+        DetachedCoroutine get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+DetachedCoroutine ticker(AlarmCallbackSystem& alarms, std::string name, std::chrono::milliseconds period,
+                         int ticks, std::function<void(const std::string&)> log, std::atomic<int>& done) {
+    for (int i = 1; i <= ticks; i++) {
+        co_await alarms.delay(period);
+        log(name + " tick " + std::to_string(i));
+    }
+    done++;
+}
+
+int main() {
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    std::mutex out_mtx;
+    auto log = [&](const std::string& what) {
+        std::lock_guard<std::mutex> lock(out_mtx);
+        std::cout << std::setw(4) << duration_cast<milliseconds>(steady_clock::now() - start).count()
+                  << " ms  " << what << '\n';
+    };
+
+    AlarmCallbackSystem alarms;
+    std::atomic<int> fired{0};
+    for (int ms : {30, 10, 20}) {
+        alarms.pushEvent([&, ms] { log("alarm due at " + std::to_string(ms) + " ms"); fired++; }, milliseconds(ms));
+    }
+    while (fired.load() < 3) std::this_thread::yield();
+
+    // 3 coroutines waiting at once, no thread blocked on any of them
+    start = steady_clock::now();
+    std::atomic<int> done{0};
+    ticker(alarms, "a", milliseconds(15), 3, log, done);
+    ticker(alarms, "b", milliseconds(20), 2, log, done);
+    ticker(alarms, "c", milliseconds(50), 1, log, done);
+    while (done.load() < 3) std::this_thread::yield();
+    return 0;
+}
@@ -62,79 +62,513 @@
 #include <mutex>
 #include <condition_variable>
 #include <optional>
+#include <deque>
+#include <coroutine>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <semaphore>
+#include <thread>
+#include <memory>
+#include <new>
+#include <bit>
+#include <cstdint>
+
+// Batch / timed operations:
+//  - try_push / try_pop never wait, pop_for / pop_until wait up to a deadline
+//  - push_bulk / pop_bulk move a whole batch under one lock and send one notification
+//    per batch (notify_one for a single item, notify_all when several slots/items appeared)
+//  - linger (constructor): pop_bulk that found fewer than max items waits up to linger
+//    for the batch to fill, trading a little latency for fewer, fuller wake-ups
+
+// QueueMode::Locked (default): std::queue under mtx_, two condition variables.
+// Every push and pop takes mtx_ for the wait and for the data move, so producers and
+// consumers serialize even when the queue is half full.
+//
+// QueueMode::SemaphoreRing: the same interface and shutdown() behaviour on top of
+//  - a lock-free ring (per-slot sequence numbers, CAS on head/tail) for the data
+//  - two counting semaphores for the accounting: free_slots_ (starts at capacity) and
+//    items_ (starts at 0). A push takes a free slot permit, writes, releases an item
+//    permit; a pop the other way round.
+// std::counting_semaphore is an atomic counter + futex: acquire only sleeps when the count
+// is 0, release only wakes when it was 0. A push or pop on a queue that is neither full nor
+// empty is a few atomic ops, no syscall and no shared lock.
+// shutdown() releases a huge number of permits on both semaphores, so every blocked thread
+// wakes; pops still drain what's left and then return std::nullopt, pushes are dropped.
+// A push that got past its last closed_ check before shutdown() is counted in pending_
+// until its item is in the ring, and pops keep draining until pending_ is back to 0:
+// like in Locked mode, a push that wasn't dropped is always delivered.
+// pop_async() is only available in Locked mode (parking coroutines needs the lock).
+
+enum class QueueMode { Locked, SemaphoreRing };
 
 template <typename T>
+class SemaphoreRingQueue {
+public:
+    SemaphoreRingQueue(size_t capacity, std::chrono::microseconds linger)
+        : capacity_(capacity),
+          mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+          linger_(linger),
+          slots_(new Slot[mask_ + 1]),
+          free_slots_(std::ptrdiff_t(capacity)) {
+        for (size_t i = 0; i <= mask_; i++)
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~SemaphoreRingQueue() {
+        std::optional<T> item;
+        while (tryTake(item)) item.reset();
+    }
+
+    template<typename... Args>
+    void push(Args&&... args) {
+        if (closed_.load(std::memory_order_acquire)) return;
+        free_slots_.acquire();
+        if (!publish(std::forward<Args>(args)...)) return;
+        items_.release();
+    }
+
+    template<typename U>
+    bool try_push(U&& item) {
+        if (closed_.load(std::memory_order_acquire) || !free_slots_.try_acquire()) return false;
+        if (!publish(std::forward<U>(item))) return false;
+        items_.release();
+        return true;
+    }
+
+    // Item permits are released once per run of pushes that found room without blocking
+    template<typename It>
+    size_t push_bulk(It first, It last) {
+        size_t pushed = 0, unannounced = 0;
+        for (; first != last; ++first) {
+            if (!free_slots_.try_acquire()) {
+                announce(unannounced);
+                free_slots_.acquire();
+            }
+            if (!publish(*first)) break;
+            unannounced++;
+            pushed++;
+        }
+        announce(unannounced);
+        return pushed;
+    }
+
+    std::optional<T> pop() {
+        items_.acquire();
+        return take();
+    }
+
+    std::optional<T> try_pop() {
+        if (!items_.try_acquire()) return std::nullopt;
+        return take();
+    }
+
+    template<typename Clock, typename Duration>
+    std::optional<T> pop_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+        if (!items_.try_acquire_until(deadline)) return std::nullopt;
+        return take();
+    }
+
+    template<typename OutIt>
+    size_t pop_bulk(OutIt out, size_t max, std::chrono::steady_clock::time_point deadline) {
+        if (max == 0 || !items_.try_acquire_until(deadline)) return 0;
+        size_t permits = 1;
+        while (permits < max && items_.try_acquire()) permits++;
+
+        size_t want = std::min(max, capacity_);
+        if (linger_.count() > 0 && permits < want && !closed_.load(std::memory_order_acquire)) {
+            auto until = std::chrono::steady_clock::now() + linger_;
+            while (permits < want && items_.try_acquire_until(until)) permits++;
+        }
+
+        size_t n = 0;
+        for (std::optional<T> item; n < permits && takeOne(item); n++) {
+            *out++ = std::move(*item);
+            item.reset();
+        }
+        if (n) free_slots_.release(std::ptrdiff_t(n));
+        return n;
+    }
+
+    void shutdown() {
+        if (closed_.exchange(true)) return;     // seq_cst: pairs with publish()
+        free_slots_.release(kWakeAll);
+        items_.release(kWakeAll);
+    }
+
+private:
+    static constexpr std::ptrdiff_t kWakeAll = std::ptrdiff_t{1} << 30;
+
+    struct alignas(64) Slot {
+        std::atomic<size_t> sequence;   // == pos: free for the push of pos, == pos + 1: holds it
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    void announce(size_t& n) {
+        if (n) items_.release(std::ptrdiff_t(n));
+        n = 0;
+    }
+
+    template<typename... Args>
+    bool tryEmplace(Args&&... args) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            intptr_t diff = intptr_t(slot.sequence.load(std::memory_order_acquire)) - intptr_t(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (slot.storage) T(std::forward<Args>(args)...);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;           // previous lap's pop hasn't finished with the slot
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryTake(std::optional<T>& item) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            intptr_t diff = intptr_t(slot.sequence.load(std::memory_order_acquire)) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* stored = std::launder(reinterpret_cast<T*>(slot.storage));
+                    item.emplace(std::move(*stored));
+                    stored->~T();
+                    slot.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;           // not written yet
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Holding a free slot permit: the slot at tail frees up as soon as its pop finishes
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        for (int spins = 0; !tryEmplace(std::forward<Args>(args)...); spins++) {
+            if (spins > kSpins) std::this_thread::yield();
+        }
+    }
+
+    // Holding a free slot permit: emplace unless shut down. Either this closed_ load sees
+    // shutdown(), or a pop that sees closed_ also sees pending_ > 0 and waits for the item.
+    template<typename... Args>
+    bool publish(Args&&... args) {
+        pending_.fetch_add(1);
+        bool open = !closed_.load();
+        if (open) emplace(std::forward<Args>(args)...);
+        pending_.fetch_sub(1, std::memory_order_release);
+        return open;
+    }
+
+    // Holding an item permit: an item is there or being written, unless it was a
+    // shutdown() permit and nothing is left (pending_ first: its release covers tail_)
+    bool takeOne(std::optional<T>& item) {
+        for (int spins = 0; !tryTake(item); spins++) {
+            if (closed_.load() && pending_.load() == 0 &&
+                head_.load(std::memory_order_acquire) >= tail_.load(std::memory_order_acquire))
+                return false;
+            if (spins > kSpins) std::this_thread::yield();
+        }
+        return true;
+    }
+
+    std::optional<T> take() {
+        std::optional<T> item;
+        if (takeOne(item)) free_slots_.release();
+        return item;
+    }
+
+    static constexpr int kSpins = 64;
+
+    const size_t capacity_;
+    const size_t mask_;
+    const std::chrono::microseconds linger_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::counting_semaphore<> free_slots_;
+    alignas(64) std::counting_semaphore<> items_{0};
+    std::atomic<bool> closed_{false};
+    std::atomic<size_t> pending_{0};    // pushes between their last closed_ check and the ring
+};
+
+// Stand-in member for Locked mode
+struct NoRingQueue {
+    NoRingQueue(size_t, std::chrono::microseconds) {}
+};
+
+template <typename T, QueueMode Mode = QueueMode::Locked>
 class BoundedBlockingQueue {
+public:
+    class PopAwaiter;
+
+private:
+    static constexpr bool kRing = Mode == QueueMode::SemaphoreRing;
+
+    [[no_unique_address]] std::conditional_t<kRing, SemaphoreRingQueue<T>, NoRingQueue> ring_;
+
     std::queue<T> queue_;
     mutable std::mutex mtx_;                    // mutable → allows const member functions if needed
     std::condition_variable cv_not_full_, cv_not_empty_;
+    std::deque<PopAwaiter*> waiters_;           // coroutines parked in pop_async(), only while queue_ is empty
     const size_t capacity_;
+    const std::chrono::microseconds linger_;
     bool shutdown_ = false;
 
-public:
-    explicit BoundedBlockingQueue(size_t capacity) : capacity_(capacity) {}
+    // A coroutine waiting in pop_async() gets the item handed over directly and is
+    // resumed on this (the pushing) thread once mtx_ is released.
+    // Called with room in the queue.
+    template<typename... Args>
+    void pushLocked(std::unique_lock<std::mutex>& lock, Args&&... args) {
+        if (!waiters_.empty()) {
+            PopAwaiter* waiter = waiters_.front();
+            waiters_.pop_front();
+            waiter->item_.emplace(std::forward<Args>(args)...);
+            lock.unlock();
+            waiter->handle_.resume();
+            return;
+        }
 
-    // Prevent copy/assignment
-    BoundedBlockingQueue(const BoundedBlockingQueue&) = delete;
-    BoundedBlockingQueue& operator=(const BoundedBlockingQueue&) = delete;
+        queue_.emplace(std::forward<Args>(args)...);
+        cv_not_empty_.notify_one();
+    }
 
-    // Producer with copy or move semantics
-    void push(const T& item) {
+    template<typename... Args>
+    void pushImpl(Args&&... args) {
+        if constexpr (kRing) {
+            ring_.push(std::forward<Args>(args)...);
+            return;
+        }
         std::unique_lock lock(mtx_);
         cv_not_full_.wait(lock, [this] {
             return queue_.size() < capacity_ || shutdown_;
         });
         if (shutdown_) return;
+        pushLocked(lock, std::forward<Args>(args)...);
+    }
 
-        queue_.push(item);
-        cv_not_empty_.notify_one();
+    // Called with an item in the queue
+    T popLocked() {
+        T item = std::move(queue_.front());
+        queue_.pop();
+        cv_not_full_.notify_one();
+        return item;
     }
 
-    void push(T&& item) {
+    template<typename U>
+    bool tryPushImpl(U&& item) {
+        if constexpr (kRing)
+            return ring_.try_push(std::forward<U>(item));
         std::unique_lock lock(mtx_);
-        cv_not_full_.wait(lock, [this] {
-            return queue_.size() < capacity_ || shutdown_;
-        });
-        if (shutdown_) return;
+        if (shutdown_ || queue_.size() >= capacity_) return false;
+        pushLocked(lock, std::forward<U>(item));
+        return true;
+    }
 
-        queue_.push(std::move(item));
-        cv_not_empty_.notify_one();
+    static void notifyBatch(std::condition_variable& cv, size_t n) {
+        if (n == 1)
+            cv.notify_one();
+        else if (n > 1)
+            cv.notify_all();
+    }
+
+public:
+    explicit BoundedBlockingQueue(size_t capacity, std::chrono::microseconds linger = {})
+        : ring_(capacity, linger), capacity_(capacity), linger_(linger) {}
+
+    // Prevent copy/assignment
+    BoundedBlockingQueue(const BoundedBlockingQueue&) = delete;
+    BoundedBlockingQueue& operator=(const BoundedBlockingQueue&) = delete;
+
+    // Producer with copy or move semantics
+    void push(const T& item) {
+        pushImpl(item);
+    }
+
+    void push(T&& item) {
+        pushImpl(std::move(item));
     }
 
     // Avoid copies for construction → universal reference
     template<typename... Args>
     void emplace(Args&&... args) {
-        std::unique_lock lock(mtx_);
-        cv_not_full_.wait(lock, [this] {
-            return queue_.size() < capacity_ || shutdown_;
-        });
-        if (shutdown_) return;
+        pushImpl(std::forward<Args>(args)...);
+    }
 
-        queue_.emplace(std::forward<Args>(args)...);
-        cv_not_empty_.notify_one();
+    // false if full or shut down; item is only moved from on success
+    bool try_push(const T& item) {
+        return tryPushImpl(item);
+    }
+
+    bool try_push(T&& item) {
+        return tryPushImpl(std::move(item));
+    }
+
+    // Pushes [first, last) in as few lock rounds as room allows, one notification per round.
+    // Blocks while full; returns how many were pushed (fewer only after shutdown).
+    template<typename It>
+    size_t push_bulk(It first, It last) {
+        if constexpr (kRing)
+            return ring_.push_bulk(first, last);
+        size_t pushed = 0;
+        std::deque<PopAwaiter*> handed;
+        while (first != last) {
+            std::unique_lock lock(mtx_);
+            cv_not_full_.wait(lock, [this] {
+                return queue_.size() < capacity_ || shutdown_;
+            });
+            if (shutdown_) break;
+
+            // Parked coroutines first (there are only any while queue_ is empty)
+            while (!waiters_.empty() && first != last) {
+                PopAwaiter* waiter = waiters_.front();
+                waiters_.pop_front();
+                waiter->item_.emplace(*first);
+                ++first;
+                handed.push_back(waiter);
+            }
+            size_t n = 0;
+            for (; first != last && queue_.size() < capacity_; ++first, ++n)
+                queue_.emplace(*first);
+            notifyBatch(cv_not_empty_, n);
+            lock.unlock();
+
+            pushed += n + handed.size();
+            for (PopAwaiter* waiter : handed)
+                waiter->handle_.resume();
+            handed.clear();
+        }
+        return pushed;
     }
 
     [[nodiscard]] std::optional<T> pop() {
+        if constexpr (kRing)
+            return ring_.pop();
         std::unique_lock lock(mtx_);
         cv_not_empty_.wait(lock, [this] {
             return !queue_.empty() || shutdown_;
         });
 
         if (shutdown_ && queue_.empty()) return std::nullopt;
+        return popLocked();
+    }
 
-        T item = std::move(queue_.front());
-        queue_.pop();
-        cv_not_full_.notify_one();
-        return item;
+    [[nodiscard]] std::optional<T> try_pop() {
+        if constexpr (kRing)
+            return ring_.try_pop();
+        std::unique_lock lock(mtx_);
+        if (queue_.empty()) return std::nullopt;
+        return popLocked();
+    }
+
+    // std::nullopt on timeout, or once shut down and drained
+    template<typename Clock, typename Duration>
+    [[nodiscard]] std::optional<T> pop_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+        if constexpr (kRing)
+            return ring_.pop_until(deadline);
+        std::unique_lock lock(mtx_);
+        if (!cv_not_empty_.wait_until(lock, deadline, [this] { return !queue_.empty() || shutdown_; }) ||
+            queue_.empty())
+            return std::nullopt;
+        return popLocked();
+    }
+
+    template<typename Rep, typename Period>
+    [[nodiscard]] std::optional<T> pop_for(const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    // Waits up to timeout for the first item, then (with linger) up to linger for the batch to
+    // fill, and moves up to max items to out under one lock. Returns how many: 0 on timeout,
+    // or once shut down and drained.
+    template<typename OutIt, typename Rep, typename Period>
+    size_t pop_bulk(OutIt out, size_t max, const std::chrono::duration<Rep, Period>& timeout) {
+        auto now = std::chrono::steady_clock::now();
+        if constexpr (kRing)
+            return ring_.pop_bulk(out, max, now + timeout);
+        std::unique_lock lock(mtx_);
+        if (!cv_not_empty_.wait_until(lock, now + timeout, [this] { return !queue_.empty() || shutdown_; }))
+            return 0;
+
+        size_t want = std::min(max, capacity_);
+        if (linger_.count() > 0 && queue_.size() < want && !shutdown_) {
+            cv_not_empty_.wait_until(lock, std::chrono::steady_clock::now() + linger_, [&] {
+                return queue_.size() >= want || shutdown_;
+            });
+        }
+
+        size_t n = 0;
+        for (; n < max && !queue_.empty(); ++n) {
+            *out++ = std::move(queue_.front());
+            queue_.pop();
+        }
+        notifyBatch(cv_not_full_, n);
+        return n;
+    }
+
+    // Coroutine version of pop(): co_await queue.pop_async() → std::optional<T>.
+    // Doesn't block a thread while the queue is empty, the coroutine is parked instead.
+    // shutdown() resumes every parked coroutine with std::nullopt.
+    class PopAwaiter {
+        friend class BoundedBlockingQueue;
+
+        BoundedBlockingQueue& queue_;
+        std::optional<T> item_;
+        std::coroutine_handle<> handle_;
+
+    public:
+        explicit PopAwaiter(BoundedBlockingQueue& queue) : queue_(queue) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        // false → don't suspend, the item (or shutdown) is already there
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::unique_lock lock(queue_.mtx_);
+            if (!queue_.queue_.empty()) {
+                item_.emplace(std::move(queue_.queue_.front()));
+                queue_.queue_.pop();
+                lock.unlock();
+                queue_.cv_not_full_.notify_one();
+                return false;
+            }
+            if (queue_.shutdown_) return false;
+
+            handle_ = handle;
+            queue_.waiters_.push_back(this);
+            return true;
+        }
+
+        std::optional<T> await_resume() { return std::move(item_); }
+    };
+
+    [[nodiscard]] PopAwaiter pop_async() requires (!kRing) {
+        return PopAwaiter(*this);
     }
 
     void shutdown() {
+        if constexpr (kRing) {
+            ring_.shutdown();
+            return;
+        }
+        std::deque<PopAwaiter*> parked;
         {
             std::lock_guard lock(mtx_);
             shutdown_ = true;
+            parked.swap(waiters_);
         }
         cv_not_full_.notify_all();
         cv_not_empty_.notify_all();
+        for (PopAwaiter* waiter : parked)
+            waiter->handle_.resume();
     }
 
     ~BoundedBlockingQueue() {
@@ -26,7 +26,7 @@ public:
     void lock(){
         bool expected = false;
         while(!locked.compare_exchange_weak(expected, true, std::memory_order_acquire)){
-
+            expected = false;   // a failed CAS wrote the current value (true) into expected
         }
     }
 
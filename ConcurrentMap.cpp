@@ -1,4 +1,53 @@
+// g++ -std=c++20 -O2 -pthread ConcurrentMap.cpp
+//   ./a.out                   → sharded map demo, 5 inserter + 5 getter threads
+//   ./a.out grow [max keys]   → get / insert latency while growing from 0 keys (default 10M;
+//                               100M keys need ~2 GB flat, ~5 GB chained), incremental vs
+//                               stop-the-world rehash
+//   ./a.out layout [keys]     → bytes per entry and lookups/s: chained nodes vs flat groups
+
+// **************** Resizable map, incremental rehash ***************
+
+// A hash table that doubles when full, split into kMapStripes lock stripes. The entries
+// live in one of two layouts (MapLayout), both tables of "units" that belong to stripe
+// unit % kMapStripes:
+//  - Chained: unit = bucket, a chain of heap nodes, up to 1 entry per bucket
+//  - Flat (default): unit = group of 16 slots with the entries inline, up to 14 per group
+//
+// Locking: kMapStripes shared_mutexes, stripe = low bits of the hash. Tables never have
+// fewer than kMapStripes units and only double, and a key is only ever placed in units of
+// its own stripe, in the old table and in the new one: one stripe lock covers the key in
+// both tables, and moving old unit u touches u's stripe only. get() takes the stripe
+// shared, insert() exclusive.
+//
+// Growing doesn't rehash everything at once:
+//  - the insert that finds its stripe at capacity allocates the doubled table (calloc:
+//    large arrays come as lazily zeroed pages, no memset pass) and swaps it in under all
+//    stripe locks, without moving a single entry. The old table stays as old_
+//  - from then on every insert moves kMigratePerInsert more old units (claimed from
+//    migrate_cursor_) into the new table, each under its own stripe lock. A moved unit is
+//    marked as such, its entries are found in the new table
+//  - lookups and inserts look in the old table first, then in the new one; new keys go to
+//    the new table
+//  - whoever moves the last unit drops the old table, again under all stripe locks, and
+//    frees it after unlocking (a big one on a short-lived thread of its own)
+// So no call does more than a handful of units, plus two O(kMapStripes) lock sweeps per
+// doubling. Options::incremental = false moves everything inside the first sweep (the
+// classic rehash) for comparison.
+//
+// Element counts are per stripe (under the stripe lock): no shared counter to bounce
+// between cores. A stripe owns 1/kMapStripes of the units, so its own count reaching its
+// share of the capacity is the growth trigger.
+
+// Q: Why stripes and not a mutex per bucket?
+// A: A shared_mutex is 56 bytes; with 100M buckets that's 5.6 GB of locks. 1024 stripes is
+//    64 KB and still makes two writers on the same lock unlikely.
+
+// Q: How can a helper tell its claim is stale (the table it claimed from is already gone)?
+// A: migrate_cursor_ holds the resize generation in its top 16 bits. The helper re-checks
+//    the generation under the stripe lock, and the generation only changes under all of them.
+
 #include <iostream>
+#include <iomanip>
 #include <mutex>
 #include <shared_mutex>
 #include <vector>
@@ -8,53 +57,415 @@
 #include <random>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <algorithm>
+#include <bit>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
 
-#define BUCKET_SIZE 16
+#include <malloc.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
+enum class MapLayout { Chained, Flat };
+
+constexpr size_t kMapStripes = 1024;
+constexpr int kMapStripeBits = 10;
+static_assert(size_t{1} << kMapStripeBits == kMapStripes);
+
+// Separate chaining: a bucket is a singly linked chain of heap nodes, 32 bytes per
+// int → int entry after malloc rounding, one pointer chase (likely a cache miss) per node.
 template <typename K, typename V>
-class ConcurrentMap {
+class ChainedTable {
+public:
+    static constexpr size_t kEntriesPerUnit = 1;
+
+    explicit ChainedTable(size_t buckets)
+        : mask_(buckets - 1), buckets_(static_cast<Node**>(std::calloc(buckets, sizeof(Node*)))) {
+        if (!buckets_) throw std::bad_alloc();
+    }
+
+    ~ChainedTable() {
+        for (size_t b = 0; b <= mask_; b++) {
+            for (Node* node = buckets_[b]; node && node != kMoved;) {
+                Node* next = node->next;
+                delete node;
+                node = next;
+            }
+        }
+        std::free(buckets_);
+    }
+
+    ChainedTable(const ChainedTable&) = delete;
+    ChainedTable& operator=(const ChainedTable&) = delete;
+
+    size_t units() const { return mask_ + 1; }
+    size_t capacity() const { return units() * kEntriesPerUnit; }
+
+    V* find(size_t hash, const K& key) const {
+        Node* chain = buckets_[hash & mask_];
+        for (; chain && chain != kMoved; chain = chain->next) {
+            if (chain->key == key) return &chain->value;
+        }
+        return nullptr;
+    }
 
-    struct BucketEntry {
+    // key isn't in the table; never full
+    template <typename KK, typename VV>
+    bool insert(size_t hash, KK&& key, VV&& value) {
+        Node*& head = buckets_[hash & mask_];
+        head = new Node{std::forward<KK>(key), std::forward<VV>(value), head};
+        return true;
+    }
+
+    // Relinks bucket b's nodes into into, b is then kMoved
+    template <typename Hash>
+    void migrate(size_t b, ChainedTable& into, Hash&& hash) {
+        for (Node* chain = buckets_[b]; chain;) {
+            Node* next = chain->next;
+            Node*& head = into.buckets_[hash(chain->key) & into.mask_];
+            chain->next = head;
+            head = chain;
+            chain = next;
+        }
+        buckets_[b] = kMoved;
+    }
+
+private:
+    struct Node {
         K key;
         V value;
+        Node* next;
     };
 
-    size_t bucket_size_{};
+    inline static Node* const kMoved = reinterpret_cast<Node*>(alignof(Node));
+
+    const size_t mask_;
+    Node** const buckets_;
+};
+
+// Open addressing, Swiss-table style: slots hold the entries inline (8 bytes for int → int),
+// and a separate array holds one control byte per slot, 16 per group:
+//  - 0x00 empty, 0x01 moved to the new table, 0x80 | top 7 hash bits for a full slot
+//  - a probe loads a group's 16 control bytes with one SSE2 load and compares all of them
+//    against the key's tag at once; only slots whose tag matches (1/128 false positives)
+//    are compared by key. A group with an empty byte ends the probe: the key would be there
+// Groups of stripe s are s, s + kMapStripes, s + 2 kMapStripes, ...; a key probes those
+// only, triangular steps (1, 2, 3, ... groups) from a start picked by the hash bits above
+// the stripe bits, which visits each of them once. Up to 14 of 16 slots per group are
+// used, so probes are almost always one group: one cache line of control bytes and one or
+// two of slots. No erase, so no tombstones; moved slots never match and never end a probe,
+// which keeps the old table searchable while it is emptied.
+template <typename K, typename V>
+class FlatTable {
+public:
+    static constexpr size_t kGroup = 16;
+    static constexpr size_t kEntriesPerUnit = 14;
 
-    size_t getHash(const K& key) const {
-        return std::hash<K>{}(key) % bucket_size_;
+    explicit FlatTable(size_t groups)
+        : local_mask_(groups / kMapStripes - 1),
+          ctrl_(static_cast<uint8_t*>(std::calloc(groups * kGroup, 1))),
+          slots_(static_cast<Slot*>(std::malloc(groups * kGroup * sizeof(Slot)))) {
+        static_assert(alignof(Slot) <= alignof(std::max_align_t));
+        if (!ctrl_ || !slots_) {
+            std::free(ctrl_);
+            std::free(slots_);
+            throw std::bad_alloc();
+        }
+    }
+
+    ~FlatTable() {
+        if constexpr (!std::is_trivially_destructible_v<Slot>) {
+            for (size_t i = 0; i < units() * kGroup; i++) {
+                if (ctrl_[i] & 0x80) slots_[i].~Slot();
+            }
+        }
+        std::free(ctrl_);
+        std::free(slots_);
     }
 
-    mutable std::vector<std::shared_mutex> mtxList_;
-    std::vector<std::list<BucketEntry>> buckets_;
+    FlatTable(const FlatTable&) = delete;
+    FlatTable& operator=(const FlatTable&) = delete;
 
+    size_t units() const { return (local_mask_ + 1) * kMapStripes; }
+    size_t capacity() const { return units() * kEntriesPerUnit; }
+
+    V* find(size_t hash, const K& key) const {
+        uint8_t tag = tagOf(hash);
+        size_t local = hash >> kMapStripeBits;
+        for (size_t step = 1; step <= local_mask_ + 1; local += step++) {
+            size_t group = groupIndex(hash, local);
+            const uint8_t* ctrl = ctrl_ + group * kGroup;
+            for (uint32_t hits = match(ctrl, tag); hits; hits &= hits - 1) {
+                Slot& slot = slots_[group * kGroup + std::countr_zero(hits)];
+                if (slot.key == key) return &slot.value;
+            }
+            if (match(ctrl, kEmpty)) return nullptr;
+        }
+        return nullptr;
+    }
+
+    // key isn't in the table; false if its groups are all full
+    template <typename KK, typename VV>
+    bool insert(size_t hash, KK&& key, VV&& value) {
+        size_t local = hash >> kMapStripeBits;
+        for (size_t step = 1; step <= local_mask_ + 1; local += step++) {
+            size_t group = groupIndex(hash, local);
+            if (uint32_t empty = match(ctrl_ + group * kGroup, kEmpty)) {
+                size_t i = group * kGroup + std::countr_zero(empty);
+                new (&slots_[i]) Slot{std::forward<KK>(key), std::forward<VV>(value)};
+                ctrl_[i] = tagOf(hash);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Moves group g's entries into into, their slots are then kMoved
+    template <typename Hash>
+    void migrate(size_t g, FlatTable& into, Hash&& hash) {
+        for (size_t i = g * kGroup; i < (g + 1) * kGroup; i++) {
+            if (!(ctrl_[i] & 0x80)) continue;
+            Slot& slot = slots_[i];
+            into.insert(hash(slot.key), std::move(slot.key), std::move(slot.value));
+            slot.~Slot();
+            ctrl_[i] = kMoved;
+        }
+    }
+
+private:
+    struct Slot {
+        K key;
+        V value;
+    };
+
+    static constexpr uint8_t kEmpty = 0x00;
+    static constexpr uint8_t kMoved = 0x01;
+
+    static uint8_t tagOf(size_t hash) { return uint8_t(0x80 | (hash >> 57)); }
+
+    size_t groupIndex(size_t hash, size_t local) const {
+        return (local & local_mask_) * kMapStripes + (hash & (kMapStripes - 1));
+    }
+
+    // Bit i set ↔ ctrl[i] == byte
+    static uint32_t match(const uint8_t* ctrl, uint8_t byte) {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(char(byte)))));
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < kGroup; i++) bits |= uint32_t(ctrl[i] == byte) << i;
+        return bits;
+#endif
+    }
+
+    const size_t local_mask_;                   // groups per stripe - 1
+    uint8_t* const ctrl_;
+    Slot* const slots_;
+};
+
+template <typename K, typename V, MapLayout Layout = MapLayout::Flat>
+class ConcurrentMap {
 public:
-    ConcurrentMap() : bucket_size_(BUCKET_SIZE), buckets_(BUCKET_SIZE), mtxList_(BUCKET_SIZE) {}
+    struct Options {
+        size_t initial_capacity = 0;    // entries before the first resize (at least kMapStripes units)
+        bool incremental = true;        // false: a resize moves every unit at once
+    };
 
-    void insert(const K& key, const V& value) {
-        size_t hash = getHash(key);
-        auto& bucket = buckets_[hash];
-        std::unique_lock<std::shared_mutex> lock(mtxList_[hash]);
-        for (auto& entry : bucket) {
-            if (entry.key == key) {
-                entry.value = value;
+private:
+    using Table = std::conditional_t<Layout == MapLayout::Flat, FlatTable<K, V>, ChainedTable<K, V>>;
+
+    static constexpr size_t kMigratePerInsert = Layout == MapLayout::Flat ? 1 : 4;
+    static constexpr int kGenerationShift = 48;
+    static constexpr size_t kBackgroundFreeUnits = size_t{1} << 20;
+
+    struct alignas(64) Stripe {
+        std::shared_mutex mtx;
+        size_t count = 0;
+    };
+
+    // std::hash is the identity for integers; spread the bits: low bits pick the stripe,
+    // the rest the bucket / group, the top 7 the flat layout's tag
+    static size_t getHash(const K& key) {
+        uint64_t h = std::hash<K>{}(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return size_t(h);
+    }
+
+    const Options options_;
+    std::unique_ptr<Stripe[]> stripes_;
+    // Both only change under every stripe lock, so any one stripe lock makes them stable
+    Table* current_;
+    Table* old_ = nullptr;
+    uint64_t generation_ = 0;
+    std::atomic<size_t> migrated_{0};                   // old_ units moved, each under its own stripe
+
+    alignas(64) std::atomic<uint64_t> migrate_cursor_{0};   // generation << 48 | next old unit
+    std::atomic<bool> resizing_{false};
+
+    Stripe& stripeOf(size_t hash) const { return stripes_[hash & (kMapStripes - 1)]; }
+
+    void lockAll() {
+        for (size_t s = 0; s < kMapStripes; s++) stripes_[s].mtx.lock();
+    }
+
+    void unlockAll() {
+        for (size_t s = 0; s < kMapStripes; s++) stripes_[s].mtx.unlock();
+    }
+
+    // Moves old unit u into the new table; caller holds u's stripe exclusively.
+    // true if that was the last one.
+    bool migrateUnit(size_t u) {
+        old_->migrate(u, *current_, getHash);
+        return migrated_.fetch_add(1, std::memory_order_acq_rel) + 1 == old_->units();
+    }
+
+    // Doubles full unless another thread already replaced it
+    void startResize(const Table* full) {
+        if (resizing_.exchange(true, std::memory_order_acq_rel)) return;
+        // Only a resizing thread writes current_, so reading it unlocked here is safe
+        if (current_ != full) {
+            resizing_.store(false, std::memory_order_release);
+            return;
+        }
+        auto bigger = std::make_unique<Table>(current_->units() * 2);
+        lockAll();
+        old_ = current_;
+        current_ = bigger.release();
+        migrated_.store(0, std::memory_order_relaxed);
+        generation_++;
+        migrate_cursor_.store(generation_ << kGenerationShift, std::memory_order_relaxed);
+        std::unique_ptr<Table> emptied;
+        if (!options_.incremental) {
+            for (size_t u = 0; u < old_->units(); u++) migrateUnit(u);
+            emptied = detachOld();
+        }
+        unlockAll();
+    }
+
+    // Every unit moved; caller holds every stripe and frees the table after unlocking
+    std::unique_ptr<Table> detachOld() {
+        std::unique_ptr<Table> emptied(old_);
+        old_ = nullptr;
+        resizing_.store(false, std::memory_order_release);
+        return emptied;
+    }
+
+    void finishResize(uint64_t generation) {
+        std::unique_ptr<Table> emptied;
+        lockAll();
+        if (generation_ == generation && old_ && migrated_ == old_->units()) emptied = detachOld();
+        unlockAll();
+        // Unmapping a GB of touched pages takes ~0.2 s: not on the inserting thread
+        if (emptied && emptied->units() >= kBackgroundFreeUnits)
+            std::thread([table = std::move(emptied)] {}).detach();
+    }
+
+    // Moves the next n old units, claimed from migrate_cursor_ in one go
+    void helpMigrate(size_t n) {
+        uint64_t claim = migrate_cursor_.fetch_add(n, std::memory_order_relaxed);
+        uint64_t generation = claim >> kGenerationShift;
+        size_t first = size_t(claim & ((uint64_t{1} << kGenerationShift) - 1));
+
+        for (size_t u = first; u < first + n; u++) {
+            bool last;
+            {
+                std::unique_lock lock(stripeOf(u).mtx);
+                if (generation != generation_ || !old_ || u >= old_->units()) return;
+                last = migrateUnit(u);
+            }
+            if (last) {
+                finishResize(generation);
                 return;
             }
         }
-        bucket.push_back({key, value});
     }
 
-    std::optional<V> get(const K& key) const {
+    // A stripe of full is at capacity. Finishes a running resize first (only if the stripe
+    // filled up before it was done), then grows.
+    void grow(const Table* full) {
+        while (resizing_.load(std::memory_order_acquire)) {
+            helpMigrate(64);
+            std::this_thread::yield();
+        }
+        startResize(full);
+    }
+
+public:
+    explicit ConcurrentMap(Options options)
+        : options_(options),
+          stripes_(new Stripe[kMapStripes]),
+          current_(new Table(std::bit_ceil(std::max(options.initial_capacity / Table::kEntriesPerUnit, kMapStripes)))) {}
+
+    ConcurrentMap() : ConcurrentMap(Options{}) {}
+
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+    ~ConcurrentMap() {
+        delete current_;
+        delete old_;
+    }
+
+    void insert(const K& key, const V& value) {
         size_t hash = getHash(key);
-        const auto& bucket = buckets_[hash];
-        std::shared_lock<std::shared_mutex> lock(mtxList_[hash]);
-        for (const auto& entry : bucket) {
-            if (entry.key == key) {
-                return entry.value;
+        Stripe& stripe = stripeOf(hash);
+        while (true) {
+            const Table* full;
+            {
+                std::unique_lock<std::shared_mutex> lock(stripe.mtx);
+                V* found = old_ ? old_->find(hash, key) : nullptr;
+                if (!found) found = current_->find(hash, key);
+                if (found) {
+                    *found = value;
+                    return;
+                }
+                // Below capacity the new table always has room, also for the old entries
+                if (stripe.count < current_->capacity() / kMapStripes) {
+                    current_->insert(hash, key, value);
+                    stripe.count++;
+                    break;
+                }
+                full = current_;
             }
+            grow(full);
         }
+        if (resizing_.load(std::memory_order_relaxed)) helpMigrate(kMigratePerInsert);
+    }
+
+    std::optional<V> get(const K& key) const {
+        size_t hash = getHash(key);
+        std::shared_lock<std::shared_mutex> lock(stripeOf(hash).mtx);
+        V* found = old_ ? old_->find(hash, key) : nullptr;
+        if (!found) found = current_->find(hash, key);
+        if (found) return *found;
         return std::nullopt;
     }
+
+    size_t size() const {
+        size_t total = 0;
+        for (size_t s = 0; s < kMapStripes; s++) {
+            std::shared_lock<std::shared_mutex> lock(stripes_[s].mtx);
+            total += stripes_[s].count;
+        }
+        return total;
+    }
+
+    // Entries the current table takes before the next resize
+    size_t capacity() const {
+        std::shared_lock<std::shared_mutex> lock(stripes_[0].mtx);
+        return current_->capacity();
+    }
 };
 
 template <typename K, typename V>
@@ -81,7 +492,202 @@ public:
     }
 };
 
-int main() {
+// **************** Benchmark: growth ***************
+
+// One writer inserts keys 0 .. max-1 (every insert that grows the table, or helps move
+// units, is in there), kReaders readers get() random keys that are already in, and must
+// find them. Every call is timed; stats per size band (10x per band). With the classic
+// rehash the insert that doubles the table moves every entry while holding every stripe,
+// so both the writer and the readers see the pause in max.
+
+struct LatencyHistogram {
+    static constexpr int kBuckets = 40;
+    uint64_t counts[kBuckets] = {};
+    uint64_t max_ns = 0;
+    uint64_t total = 0;
+
+    void add(uint64_t ns) {
+        counts[std::min(kBuckets - 1, int(std::bit_width(ns)))]++;
+        max_ns = std::max(max_ns, ns);
+        total++;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < kBuckets; i++) counts[i] += other.counts[i];
+        max_ns = std::max(max_ns, other.max_ns);
+        total += other.total;
+    }
+
+    // Upper bound of the bucket holding the q-quantile
+    uint64_t percentile(double q) const {
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += counts[i];
+            if (seen >= q * total) return i == 0 ? 0 : (uint64_t{1} << i) - 1;
+        }
+        return max_ns;
+    }
+};
+
+inline uint64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void growMap(uint64_t max_keys, bool incremental) {
+    constexpr int kReaders = 2;
+    constexpr int kMaxBands = 12;
+
+    std::vector<uint64_t> bands;                        // upper end of each size band
+    for (uint64_t end = 1000; end < max_keys; end *= 10) bands.push_back(end);
+    bands.push_back(max_keys);
+
+    ConcurrentMap<uint64_t, uint64_t> map({.incremental = incremental});
+    std::atomic<uint64_t> inserted{0};
+    std::atomic<int> band{0};
+    std::atomic<bool> done{false}, ok{true};
+    std::vector<LatencyHistogram> inserts(kMaxBands), gets(kMaxBands);
+    std::vector<double> seconds(kMaxBands);
+    std::mutex gets_mtx;
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kReaders; r++) {
+        readers.emplace_back([&, r] {
+            std::vector<LatencyHistogram> local(kMaxBands);
+            std::mt19937_64 rng(r);
+            while (!done.load(std::memory_order_relaxed)) {
+                uint64_t n = inserted.load(std::memory_order_acquire);
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                uint64_t key = rng() % n;
+                int b = band.load(std::memory_order_relaxed);
+                uint64_t start = steadyNs();
+                auto value = map.get(key);
+                local[b].add(steadyNs() - start);
+                if (!value || *value != key * 10) ok = false;
+            }
+            std::lock_guard lock(gets_mtx);
+            for (int b = 0; b < kMaxBands; b++) gets[b].merge(local[b]);
+        });
+    }
+
+    uint64_t key = 0;
+    for (size_t b = 0; b < bands.size(); b++) {
+        band.store(int(b), std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        for (; key < bands[b]; key++) {
+            uint64_t t = steadyNs();
+            map.insert(key, key * 10);
+            inserts[b].add(steadyNs() - t);
+            inserted.store(key + 1, std::memory_order_release);
+        }
+        seconds[b] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    done = true;
+    for (auto& t : readers) t.join();
+    if (map.size() != max_keys) ok = false;
+
+    std::cout << (incremental ? "incremental rehash" : "stop-the-world rehash") << ", " << kReaders
+              << " readers, final capacity " << map.capacity() << (ok ? "" : "  ! lookup failed") << '\n';
+    std::cout << "keys up to     M inserts/s  insert p99       max    M gets/s   get p50      p99    p99.9       max (us)\n";
+    uint64_t from = 0;
+    for (size_t b = 0; b < bands.size(); b++) {
+        const LatencyHistogram& g = gets[b];
+        std::cout << std::setw(11) << bands[b] << std::fixed << std::setprecision(2) << std::setw(14)
+                  << (bands[b] - from) / seconds[b] / 1e6 << std::setprecision(1) << std::setw(12)
+                  << inserts[b].percentile(0.99) / 1e3 << std::setw(10) << inserts[b].max_ns / 1e3
+                  << std::setprecision(2) << std::setw(12) << g.total / seconds[b] / 1e6 << std::setprecision(1);
+        for (double q : {0.5, 0.99, 0.999}) std::cout << std::setw(9) << g.percentile(q) / 1e3;
+        std::cout << std::setw(10) << g.max_ns / 1e3 << '\n';
+        from = bands[b];
+    }
+}
+
+// **************** Benchmark: layout ***************
+
+// int → int, keys 0 .. n-1 inserted by one thread, then looked up in random order: keys
+// that are in (hits) and keys that never were (misses: a miss scans until the end of the
+// chain / the first group with an empty slot). Lookups run on every hardware thread.
+// Bytes per entry = heap growth (glibc mallinfo2: malloc'ed + mmapped bytes) / n: nodes,
+// bucket / control / slot arrays, stripes, and the capacity not used yet (fill = how far
+// the table is toward its next doubling).
+
+inline size_t heapBytes() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+inline uint64_t nextRandom(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+template <MapLayout Layout>
+void measureLayout(const char* name, int keys, uint64_t lookups) {
+    int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    size_t before = heapBytes();
+    auto map = std::make_unique<ConcurrentMap<int, int, Layout>>();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int key = 0; key < keys; key++) map->insert(key, key * 10);
+    double insert_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double bytes_per_entry = double(heapBytes() - before) / keys;
+
+    std::atomic<bool> ok{true};
+    auto lookup = [&](bool hits) {
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                uint64_t state = 0x9e3779b97f4a7c15ULL + t;
+                uint64_t found = 0;
+                for (uint64_t i = 0; i < lookups / threads; i++) {
+                    int key = int(nextRandom(state) % uint64_t(keys));
+                    found += map->get(hits ? key : key + keys).has_value();
+                }
+                if (found != (hits ? lookups / threads : 0)) ok = false;
+            });
+        }
+        for (auto& w : workers) w.join();
+        return lookups / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    };
+    double hits = lookup(true), misses = lookup(false);
+
+    std::cout << std::left << std::setw(10) << name << std::right << std::setw(11) << keys << std::fixed
+              << std::setprecision(1) << std::setw(11) << bytes_per_entry << std::setw(7)
+              << 100.0 * map->size() / map->capacity() << '%' << std::setprecision(2) << std::setw(13)
+              << keys / insert_s / 1e6 << std::setw(11) << hits / 1e6 << std::setw(13) << misses / 1e6
+              << (ok ? "" : "  !") << '\n';
+}
+
+void benchLayouts(int max_keys) {
+    constexpr uint64_t kLookups = 10000000;
+    std::cout << std::thread::hardware_concurrency() << " lookup threads\n"
+              << "layout          keys  bytes/entry  fill   M inserts/s  M hits/s  M misses/s\n";
+    for (int keys = 1000; keys <= max_keys; keys *= 10) {
+        measureLayout<MapLayout::Chained>("chained", keys, kLookups);
+        measureLayout<MapLayout::Flat>("flat", keys, kLookups);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "grow") {
+        uint64_t max_keys = argc > 2 ? std::stoull(argv[2]) : 10000000;
+        growMap(max_keys, true);
+        std::cout << '\n';
+        growMap(max_keys, false);
+        return 0;
+    }
+    if (mode == "layout") {
+        benchLayouts(argc > 2 ? std::stoi(argv[2]) : 10000000);
+        return 0;
+    }
+
     ConcurrentShardMap<int, int> map(5);
 
     constexpr int numThreads = 10;
@@ -0,0 +1,734 @@
+// g++ -std=c++20 -O2 -pthread ConcurrentQueue.cpp
+//   ./a.out        → MPMCQueue vs BoundedBlockingQueue, 1..32 producers x 1..32 consumers
+//   ./a.out pool   → RingPool (ThreadPool on top of MPMCQueue) throughput
+//   ./a.out linked → unbounded LinkedQueue (epoch / hazard pointers) vs MPMCQueue
+//   ./a.out batch  → BoundedBlockingQueue push_bulk / pop_bulk at batch 1, 16, 256
+//   ./a.out latency → BoundedBlockingQueue Locked vs SemaphoreRing: push → pop latency histogram
+
+// **************** Lock-free bounded MPMC queue ***************
+
+// Every other queue in this repo is a std::queue behind a mutex. MPMCQueue is a fixed
+// array of slots, each with its own sequence number (Dmitry Vyukov's bounded queue):
+//  - slot i is free for the producer that claims position p (p % capacity == i) when
+//    sequence == p, and full for the consumer claiming p when sequence == p + 1
+//  - producers claim positions with a CAS on tail_, consumers with a CAS on head_; after
+//    that the slot is theirs alone, so the element itself is written/read without atomics
+//  - the consumer frees the slot for the next lap with sequence = p + capacity
+// Nobody ever waits on a lock: a thread that loses a CAS retries with the new position,
+// a full/empty queue makes try_push/try_pop return false right away.
+// head_, tail_ and every slot sit on their own cache line, so producers and consumers
+// only share the lines of the slots they are actually handing over.
+
+// Q: Why not just an atomic head/tail ring like the SPSC one?
+// A: With several producers, "claim a slot" and "element is written" are two steps. The
+//    per-slot sequence is what tells a consumer the second step happened, and tells a
+//    producer the consumer of the previous lap is really done with the slot.
+
+// Q: Is it wait-free?
+// A: No, lock-free: a thread can lose the CAS any number of times, but every lost CAS
+//    means another thread made progress. A producer that is preempted between claiming
+//    and publishing does hold up consumers of that one slot (not the others).
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <new>
+#include <optional>
+#include <chrono>
+#include <functional>
+#include <semaphore>
+#include <mutex>
+#include <string>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "BoundedBlockingQueue.cpp"        // the mutex-based queue benchmarked against (no main)
+#include "MemoryReclamation.cpp"          // EpochDomain, HazardDomain (no main)
+
+constexpr size_t kCacheLine = 64;
+
+template <typename T>
+class MPMCQueue {
+public:
+    // Rounded up to a power of two
+    explicit MPMCQueue(size_t capacity)
+        : capacity_(std::bit_ceil(std::max<size_t>(capacity, 2))),
+          mask_(capacity_ - 1),
+          slots_(new Slot[capacity_]) {
+        for (size_t i = 0; i < capacity_; i++)
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    // No other thread may be using the queue any more
+    ~MPMCQueue() {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (size_t pos = head_.load(); pos != tail_.load(); pos++)
+                slots_[pos & mask_].item()->~T();
+        }
+    }
+
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
+        size_t pos;
+        Slot* slot = claim(tail_, 0, pos);
+        if (!slot) return false;
+        ::new (slot->item()) T(std::forward<Args>(args)...);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(const T& item) { return try_emplace(item); }
+    bool try_push(T&& item) { return try_emplace(std::move(item)); }
+
+    bool try_pop(T& out) {
+        size_t pos;
+        Slot* slot = claim(head_, 1, pos);
+        if (!slot) return false;
+        out = std::move(*slot->item());
+        slot->item()->~T();
+        slot->sequence.store(pos + capacity_, std::memory_order_release);
+        return true;
+    }
+
+    // Moves up to n items from first. One CAS claims the whole run of free slots.
+    // Returns how many were pushed (fewer than n only if the queue filled up).
+    template <typename It>
+    size_t try_push_bulk(It first, size_t n) {
+        size_t pos, count = claimRun(tail_, 0, n, pos);
+        for (size_t i = 0; i < count; i++, ++first) {
+            Slot& slot = slots_[(pos + i) & mask_];
+            ::new (slot.item()) T(std::move(*first));
+            slot.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // Pops up to max items into out (an output iterator). Returns how many.
+    template <typename OutIt>
+    size_t try_pop_bulk(OutIt out, size_t max) {
+        size_t pos, count = claimRun(head_, 1, max, pos);
+        for (size_t i = 0; i < count; i++) {
+            Slot& slot = slots_[(pos + i) & mask_];
+            *out++ = std::move(*slot.item());
+            slot.item()->~T();
+            slot.sequence.store(pos + i + capacity_, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // Only a snapshot: other threads may change it before the caller looks at it
+    size_t size_approx() const {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    struct alignas(kCacheLine) Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* item() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    // ready == 0: producer (slot must be free), ready == 1: consumer (slot must be full)
+    Slot* claim(std::atomic<size_t>& cursor, size_t ready, size_t& pos) {
+        pos = cursor.load(std::memory_order_relaxed);
+        while (true) {
+            Slot* slot = &slots_[pos & mask_];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - (pos + ready));
+            if (diff == 0) {
+                if (cursor.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return slot;
+            } else if (diff < 0) {
+                return nullptr;                 // full (producer) / empty (consumer)
+            } else {
+                pos = cursor.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Claims the longest run (≤ max) of ready slots starting at the cursor, with one CAS.
+    // A slot that is ready for position p can only change hands through the thread that
+    // claims p, so winning the CAS for the whole run makes every slot in it ours.
+    // The run stops at the first slot that isn't ready (e.g. a producer still writing it).
+    size_t claimRun(std::atomic<size_t>& cursor, size_t ready, size_t max, size_t& pos) {
+        if (max == 0) return 0;
+        pos = cursor.load(std::memory_order_relaxed);
+        while (true) {
+            size_t count = 0;
+            while (count < max) {
+                size_t seq = slots_[(pos + count) & mask_].sequence.load(std::memory_order_acquire);
+                if (seq != pos + count + ready) break;
+                count++;
+            }
+            if (count == 0) {
+                size_t seq = slots_[pos & mask_].sequence.load(std::memory_order_acquire);
+                if (static_cast<std::ptrdiff_t>(seq - (pos + ready)) < 0) return 0;
+                pos = cursor.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (cursor.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                return count;
+        }
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};      // next position to push
+    alignas(kCacheLine) std::atomic<size_t> head_{0};      // next position to pop
+};
+
+// **************** Unbounded lock-free queue ***************
+
+// When no capacity can be picked up front: Michael & Scott's linked queue. head_ points at
+// a dummy node, the first element lives in head_->next; pop swings head_ to that node,
+// which becomes the new dummy, and retires the old one. A push links its node after the
+// last one, then swings tail_ (anyone who finds tail_ lagging helps it along).
+// Every node a thread touches after loading it is protected through the Reclaim domain:
+// slot 0 for head_/tail_, slot 1 for head_->next.
+
+template <typename T, typename Reclaim = EpochDomain>
+class LinkedQueue {
+public:
+    explicit LinkedQueue(Reclaim& reclaim = Reclaim::shared()) : reclaim_(reclaim) {
+        Node* dummy = new Node;
+        head_.store(dummy, std::memory_order_relaxed);
+        tail_.store(dummy, std::memory_order_relaxed);
+    }
+
+    LinkedQueue(const LinkedQueue&) = delete;
+    LinkedQueue& operator=(const LinkedQueue&) = delete;
+
+    // No other thread may be using the queue any more
+    ~LinkedQueue() {
+        for (Node* node = head_.load(); node;) {
+            Node* next = node->next.load(std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        Node* node = new Node;
+        node->value.emplace(std::forward<Args>(args)...);
+
+        auto guard = reclaim_.guard();
+        while (true) {
+            Node* tail = guard.protect(0, tail_);
+            Node* next = tail->next.load(std::memory_order_acquire);
+            if (next) {
+                tail_.compare_exchange_weak(tail, next, std::memory_order_release, std::memory_order_relaxed);
+                continue;
+            }
+            if (tail->next.compare_exchange_weak(next, node, std::memory_order_release, std::memory_order_relaxed)) {
+                tail_.compare_exchange_strong(tail, node, std::memory_order_release, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    void push(T value) { emplace(std::move(value)); }
+
+    bool try_pop(T& out) {
+        Node* old_head;
+        {
+            auto guard = reclaim_.guard();
+            while (true) {
+                Node* head = guard.protect(0, head_);
+                Node* next = guard.protect(1, head->next);
+                if (head != head_.load(std::memory_order_acquire))
+                    continue;                               // next may already be retired
+                if (!next)
+                    return false;
+                Node* tail = tail_.load(std::memory_order_acquire);
+                if (head == tail) {                         // tail_ lags behind, help first
+                    tail_.compare_exchange_weak(tail, next, std::memory_order_release, std::memory_order_relaxed);
+                    continue;
+                }
+                if (head_.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                    // Only the winner touches next->value; next stays alive as the new dummy
+                    out = std::move(*next->value);
+                    next->value.reset();
+                    old_head = head;
+                    break;
+                }
+            }
+        }
+        reclaim_.retire(old_head);
+        return true;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::optional<T> value;
+    };
+
+    Reclaim& reclaim_;
+    alignas(kCacheLine) std::atomic<Node*> head_;
+    alignas(kCacheLine) std::atomic<Node*> tail_;
+};
+
+// **************** RingPool ***************
+
+// Backing store check: a fixed pool whose queue is an MPMCQueue of std::function.
+// Submitters never touch a mutex; a counting semaphore counts queued tasks, so a worker
+// only sleeps when there is really nothing to take. enqueue returns false when the ring
+// is full, so back-pressure is the caller's decision (retry, run inline, drop).
+
+class RingPool {
+public:
+    RingPool(size_t num_threads, size_t capacity) : queue_(capacity) {
+        for (size_t i = 0; i < num_threads; i++)
+            workers_.emplace_back([this] { worker(); });
+    }
+
+    RingPool(const RingPool&) = delete;
+    RingPool& operator=(const RingPool&) = delete;
+
+    bool try_enqueue(std::function<void()> task) {
+        if (!queue_.try_push(std::move(task))) return false;
+        available_.release();
+        return true;
+    }
+
+    // Everything queued before stop() still runs
+    void stop() {
+        if (stop_.exchange(true)) return;
+        available_.release(workers_.size());
+        for (auto& t : workers_) t.join();
+    }
+
+    ~RingPool() {
+        stop();
+    }
+
+private:
+    void worker() {
+        std::function<void()> task;
+        while (true) {
+            available_.acquire();
+            if (queue_.try_pop(task)) {
+                task();
+                task = nullptr;
+            } else if (stop_.load(std::memory_order_acquire)) {
+                return;
+            } else {
+                available_.release();       // head slot still being written by a slower producer: retry
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    MPMCQueue<std::function<void()>> queue_;
+    std::counting_semaphore<> available_{0};
+    std::atomic<bool> stop_{false};
+    std::vector<std::thread> workers_;
+};
+
+// **************** Benchmark ***************
+
+// items go from P producers to C consumers through a queue of 1024, every run moves the
+// same total. Mops/s of:
+//  - BoundedBlockingQueue<uint64_t> (mutex + two condition variables, blocking)
+//  - MPMCQueue try_push/try_pop, yielding when full/empty
+//  - MPMCQueue with try_push_bulk/try_pop_bulk of 32
+// The sum of everything popped is checked against what was pushed.
+
+template <typename F>
+double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct RunResult {
+    double ms;
+    bool ok;
+};
+
+RunResult runBlocking(int producers, int consumers, uint64_t items) {
+    BoundedBlockingQueue<uint64_t> queue(1024);
+    std::atomic<uint64_t> sum{0};
+    std::vector<std::thread> threads;
+
+    double ms = timeMs([&] {
+        for (int c = 0; c < consumers; c++) {
+            threads.emplace_back([&] {
+                uint64_t local = 0;
+                while (auto v = queue.pop()) local += *v;
+                sum += local;
+            });
+        }
+        std::vector<std::thread> senders;
+        for (int p = 0; p < producers; p++) {
+            senders.emplace_back([&, p] {
+                for (uint64_t i = p; i < items; i += producers) queue.push(i + 1);
+            });
+        }
+        for (auto& t : senders) t.join();
+        queue.shutdown();                   // consumers drain what's left, then see nullopt
+        for (auto& t : threads) t.join();
+    });
+    return {ms, sum == items * (items + 1) / 2};
+}
+
+RunResult runRing(int producers, int consumers, uint64_t items, size_t batch) {
+    MPMCQueue<uint64_t> queue(1024);
+    std::atomic<uint64_t> sum{0};
+    std::atomic<bool> producers_done{false};
+    std::vector<std::thread> threads;
+
+    double ms = timeMs([&] {
+        for (int c = 0; c < consumers; c++) {
+            threads.emplace_back([&, batch] {
+                std::vector<uint64_t> buffer(batch);
+                uint64_t local = 0;
+                while (true) {
+                    size_t n = batch == 1 ? queue.try_pop(buffer[0]) : queue.try_pop_bulk(buffer.begin(), batch);
+                    if (n == 0) {
+                        // Every push is published before producers_done is set
+                        if (producers_done.load(std::memory_order_acquire) && queue.size_approx() == 0) break;
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    for (size_t i = 0; i < n; i++) local += buffer[i];
+                }
+                sum += local;
+            });
+        }
+        std::vector<std::thread> senders;
+        for (int p = 0; p < producers; p++) {
+            senders.emplace_back([&, p, batch] {
+                std::vector<uint64_t> buffer;
+                for (uint64_t i = p; i < items; i += producers) {
+                    buffer.push_back(i + 1);
+                    if (buffer.size() < batch && i + producers < items) continue;
+
+                    size_t sent = 0;
+                    while (sent < buffer.size()) {
+                        size_t n = batch == 1 ? queue.try_push(buffer[0])
+                                              : queue.try_push_bulk(buffer.begin() + sent, buffer.size() - sent);
+                        if (n == 0) std::this_thread::yield();
+                        sent += n;
+                    }
+                    buffer.clear();
+                }
+            });
+        }
+        for (auto& t : senders) t.join();
+        producers_done.store(true, std::memory_order_release);
+        for (auto& t : threads) t.join();
+    });
+    return {ms, sum == items * (items + 1) / 2};
+}
+
+void benchQueues() {
+    constexpr uint64_t kItems = 2000000;
+    const std::pair<int, int> shapes[] = {{1, 1}, {1, 4}, {4, 1}, {2, 2}, {4, 4}, {8, 8},
+                                          {16, 16}, {32, 32}, {1, 32}, {32, 1}};
+
+    std::cout << "producers x consumers   BBQ Mops/s   ring Mops/s   ring bulk(32) Mops/s\n";
+    for (auto [p, c] : shapes) {
+        RunResult results[] = {runBlocking(p, c, kItems), runRing(p, c, kItems, 1), runRing(p, c, kItems, 32)};
+        std::cout << std::setw(9) << p << " x " << std::setw(2) << c << "       ";
+        for (auto& r : results) {
+            std::cout << std::fixed << std::setprecision(2) << std::setw(12) << kItems / r.ms / 1000
+                      << (r.ok ? "  " : " !");
+        }
+        std::cout << '\n';
+    }
+}
+
+void benchRingPool() {
+    constexpr long kTasks = 1000000;
+    RingPool pool(4, 4096);
+    std::atomic<long> done{0};
+    double ms = timeMs([&] {
+        for (long i = 0; i < kTasks; i++) {
+            while (!pool.try_enqueue([&done] { done.fetch_add(1, std::memory_order_relaxed); }))
+                std::this_thread::yield();
+        }
+        while (done.load() < kTasks) std::this_thread::yield();
+    });
+    std::cout << "RingPool: " << kTasks << " tasks in " << std::fixed << std::setprecision(0) << ms
+              << " ms, " << std::setprecision(0) << ms * 1e6 / kTasks << " ns/task\n";
+}
+
+// Same hand-off as runRing (batch 1), through an unbounded LinkedQueue: every push is a
+// new node, every pop retires one to the domain.
+template <typename Domain>
+RunResult runLinked(int producers, int consumers, uint64_t items) {
+    Domain domain;
+    LinkedQueue<uint64_t, Domain> queue(domain);
+    std::atomic<uint64_t> sum{0};
+    std::atomic<int> producers_left{producers};
+    std::vector<std::thread> threads;
+
+    double ms = timeMs([&] {
+        for (int c = 0; c < consumers; c++) {
+            threads.emplace_back([&] {
+                uint64_t local = 0, value = 0;
+                while (true) {
+                    if (queue.try_pop(value)) {
+                        local += value;
+                        continue;
+                    }
+                    // Every push happens before its producer's fetch_sub
+                    if (producers_left.load(std::memory_order_acquire) == 0) {
+                        while (queue.try_pop(value)) local += value;
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+                sum += local;
+            });
+        }
+        for (int p = 0; p < producers; p++) {
+            threads.emplace_back([&, p] {
+                for (uint64_t i = p; i < items; i += producers) queue.push(i + 1);
+                producers_left.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        for (auto& t : threads) t.join();
+    });
+    return {ms, sum == items * (items + 1) / 2};
+}
+
+void benchLinked() {
+    constexpr uint64_t kItems = 2000000;
+    const std::pair<int, int> shapes[] = {{1, 1}, {4, 4}, {16, 16}, {1, 16}, {16, 1}};
+
+    std::cout << "producers x consumers   linked+epoch Mops/s   linked+hazard Mops/s   ring Mops/s\n";
+    for (auto [p, c] : shapes) {
+        RunResult results[] = {runLinked<EpochDomain>(p, c, kItems), runLinked<HazardDomain>(p, c, kItems),
+                               runRing(p, c, kItems, 1)};
+        std::cout << std::setw(9) << p << " x " << std::setw(2) << c << "       ";
+        for (auto& r : results) {
+            std::cout << std::fixed << std::setprecision(2) << std::setw(18) << kItems / r.ms / 1000
+                      << (r.ok ? "  " : " !");
+        }
+        std::cout << '\n';
+    }
+}
+
+// BoundedBlockingQueue batch ops: producers push_bulk `push_batch` and consumers pop_bulk
+// `batch` items at a time (1 = push / pop), optionally lingering for the batch to fill.
+// Also reports items per pop call (how many a consumer got per wake-up / lock round): with
+// single-item producers that is where linger shows.
+RunResult runBatched(int producers, int consumers, uint64_t items, size_t push_batch, size_t batch,
+                     std::chrono::microseconds linger, double& items_per_pop) {
+    BoundedBlockingQueue<uint64_t> queue(1024, linger);
+    std::atomic<uint64_t> sum{0}, pops{0};
+    std::atomic<bool> finished{false};
+    std::vector<std::thread> threads;
+
+    double ms = timeMs([&] {
+        for (int c = 0; c < consumers; c++) {
+            threads.emplace_back([&] {
+                std::vector<uint64_t> buffer(batch);
+                uint64_t local = 0, calls = 0;
+                while (true) {
+                    size_t n = 0;
+                    if (batch == 1) {
+                        if (auto v = queue.pop()) buffer[n++] = *v;
+                    } else {
+                        n = queue.pop_bulk(buffer.begin(), batch, std::chrono::milliseconds(100));
+                    }
+                    if (n == 0) {
+                        if (finished.load()) break;     // shut down and drained
+                        continue;
+                    }
+                    calls++;
+                    for (size_t i = 0; i < n; i++) local += buffer[i];
+                }
+                sum += local;
+                pops += calls;
+            });
+        }
+        std::vector<std::thread> senders;
+        for (int p = 0; p < producers; p++) {
+            senders.emplace_back([&, p] {
+                std::vector<uint64_t> buffer;
+                for (uint64_t i = p; i < items; i += producers) {
+                    if (push_batch == 1) {
+                        queue.push(i + 1);
+                        continue;
+                    }
+                    buffer.push_back(i + 1);
+                    if (buffer.size() == push_batch || i + producers >= items) {
+                        queue.push_bulk(buffer.begin(), buffer.end());
+                        buffer.clear();
+                    }
+                }
+            });
+        }
+        for (auto& t : senders) t.join();
+        finished = true;
+        queue.shutdown();
+        for (auto& t : threads) t.join();
+    });
+    items_per_pop = pops ? double(items) / pops : 0;
+    return {ms, sum == items * (items + 1) / 2};
+}
+
+void benchBatches() {
+    constexpr uint64_t kItems = 2000000;
+    const std::pair<int, int> shapes[] = {{1, 1}, {4, 4}, {16, 16}};
+    const std::chrono::microseconds lingers[] = {std::chrono::microseconds(0), std::chrono::microseconds(50)};
+
+    auto row = [&](int p, int c, size_t push_batch, size_t batch, std::chrono::microseconds linger) {
+        double per_pop = 0;
+        RunResult r = runBatched(p, c, kItems, push_batch, batch, linger, per_pop);
+        std::cout << std::setw(9) << p << " x " << std::setw(2) << c << std::setw(9) << push_batch << " / "
+                  << std::setw(3) << batch << std::setw(12) << linger.count() << std::fixed << std::setprecision(2)
+                  << std::setw(9) << kItems / r.ms / 1000 << (r.ok ? "  " : " !")
+                  << std::setprecision(1) << std::setw(14) << per_pop << '\n';
+    };
+
+    std::cout << "producers x consumers   push / pop batch   linger us   Mops/s   items per pop\n";
+    for (auto [p, c] : shapes) {
+        for (size_t batch : {1, 16, 256}) {
+            for (auto linger : lingers) {
+                if (batch > 1 || !linger.count()) row(p, c, batch, batch, linger);
+            }
+        }
+        for (auto linger : lingers) row(p, c, 1, 256, linger);
+    }
+}
+
+// push → pop latency of BoundedBlockingQueue in both modes. Items are steady_clock ns
+// stamps; consumers record now - stamp in log2 buckets. Producers either pace themselves
+// (kPaceNs between pushes each, the queue stays nearly empty: hand-off latency) or push
+// flat out (queue full: mostly queueing delay, plus throughput).
+
+struct LatencyHistogram {
+    static constexpr int kBuckets = 40;
+    uint64_t counts[kBuckets] = {};
+    uint64_t max_ns = 0;
+    uint64_t total = 0;
+
+    void add(uint64_t ns) {
+        counts[std::min(kBuckets - 1, int(std::bit_width(ns)))]++;
+        max_ns = std::max(max_ns, ns);
+        total++;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < kBuckets; i++) counts[i] += other.counts[i];
+        max_ns = std::max(max_ns, other.max_ns);
+        total += other.total;
+    }
+
+    // Upper bound of the bucket holding the q-quantile
+    uint64_t percentile(double q) const {
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += counts[i];
+            if (seen >= q * total) return i == 0 ? 0 : (uint64_t{1} << i) - 1;
+        }
+        return max_ns;
+    }
+};
+
+inline uint64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <QueueMode Mode>
+LatencyHistogram runLatency(int producers, int consumers, uint64_t items, uint64_t pace_ns, double& ms) {
+    BoundedBlockingQueue<uint64_t, Mode> queue(1024);
+    LatencyHistogram histogram;
+    std::mutex histogram_mtx;
+    std::vector<std::thread> threads;
+
+    ms = timeMs([&] {
+        for (int c = 0; c < consumers; c++) {
+            threads.emplace_back([&] {
+                LatencyHistogram local;
+                while (auto stamp = queue.pop()) local.add(steadyNs() - *stamp);
+                std::lock_guard lock(histogram_mtx);
+                histogram.merge(local);
+            });
+        }
+        std::vector<std::thread> senders;
+        for (int p = 0; p < producers; p++) {
+            senders.emplace_back([&, p] {
+                uint64_t next = steadyNs();
+                for (uint64_t i = p; i < items; i += producers) {
+                    if (pace_ns) {
+                        next += pace_ns;
+                        while (steadyNs() < next) std::this_thread::yield();
+                    }
+                    queue.push(steadyNs());
+                }
+            });
+        }
+        for (auto& t : senders) t.join();
+        queue.shutdown();
+        for (auto& t : threads) t.join();
+    });
+    return histogram;
+}
+
+void benchLatency() {
+    constexpr uint64_t kItems = 400000;
+    constexpr uint64_t kPaceNs = 20000;
+    const std::pair<int, int> shapes[] = {{1, 1}, {4, 4}};
+
+    std::cout << "mode            producers x consumers   load     Mops/s      p50      p90      p99    p99.9      max (us)\n";
+    auto row = [&](const char* name, int p, int c, bool paced, auto run) {
+        double ms = 0;
+        uint64_t items = paced ? kItems / 20 : kItems;
+        LatencyHistogram h = run(p, c, items, paced ? kPaceNs : 0, ms);
+        std::cout << std::left << std::setw(16) << name << std::right << std::setw(9) << p << " x " << std::setw(2) << c
+                  << std::setw(15) << (paced ? "paced" : "flat out") << std::fixed << std::setprecision(2)
+                  << std::setw(9) << items / ms / 1000 << (h.total == items ? "  " : " !") << std::setprecision(1);
+        for (double q : {0.5, 0.9, 0.99, 0.999}) std::cout << std::setw(9) << h.percentile(q) / 1e3;
+        std::cout << std::setw(9) << h.max_ns / 1e3 << '\n';
+    };
+    for (bool paced : {true, false}) {
+        for (auto [p, c] : shapes) {
+            row("Locked", p, c, paced, runLatency<QueueMode::Locked>);
+            row("SemaphoreRing", p, c, paced, runLatency<QueueMode::SemaphoreRing>);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "pool") {
+        benchRingPool();
+        return 0;
+    }
+    if (mode == "linked") {
+        benchLinked();
+        return 0;
+    }
+    if (mode == "batch") {
+        benchBatches();
+        return 0;
+    }
+    if (mode == "latency") {
+        benchLatency();
+        return 0;
+    }
+    benchQueues();
+    return 0;
+}
@@ -0,0 +1,437 @@
+// g++ -std=c++20 -O2 -pthread ConcurrentStack.cpp
+//   ./a.out [max threads]  → mutex + std::stack vs Treiber vs Treiber + elimination, 1..64 threads
+//   ./a.out reclaim        → epoch vs hazard pointer reclamation with a stalled reader
+
+// **************** Lock-free stack (Treiber) ***************
+
+// A LIFO for object / buffer free-lists: push = CAS the new node in as head, pop = CAS
+// head over to head->next.
+//
+// ABA: thread A reads head = X and X->next = Y, gets preempted; B pops X, pops Y, pushes
+// X back. A's CAS(head: X → Y) still succeeds and Y (no longer on the stack) becomes head.
+// Fix used here: head is a tagged pointer (48-bit address + 16-bit counter bumped on every
+// change), so A's CAS compares against a stale tag and fails. It would take exactly 65536
+// changes of head between A's load and A's CAS to fool it.
+//
+// Reclamation: A may still read X->next after B popped X. That is only safe if X's memory
+// is still a node. With the default RecycleNodes, popped nodes are never deleted while the
+// stack lives: they go to a second tagged stack of spare nodes that push() reuses
+// (type-stable memory), and reading a recycled node's next is harmless, the tag makes the
+// CAS fail. That suits a free-list that stays around; a stack whose size comes and goes
+// can use an EpochDomain or HazardDomain (MemoryReclamation.cpp) instead, popped nodes are
+// then retired and deleted once no pop can still be reading them.
+//
+// Elimination: when a CAS on head fails (contention), a push and a pop can pair off in a
+// small array of exchange slots instead of retrying on the one hot cache line:
+//  - push parks its node in a random empty slot and spins briefly; if a pop took it the
+//    push is done, otherwise it takes the node back and retries on head
+//  - pop looks at a random slot and, if a node is parked there, takes it
+// An eliminated push/pop pair is still linearizable: the push happens right before the pop.
+
+// Q: Why not std::atomic<std::shared_ptr<Node>>?
+// A: It solves reclamation, but libstdc++ implements it with a lock (is_lock_free() is
+//    false), so the stack would not be lock-free any more.
+
+// Q: Why not a 16-byte {pointer, counter} and cmpxchg16b?
+// A: Works, but std::atomic of 16 bytes goes through libatomic and isn't reliably lock-free
+//    across compilers. x86-64 / AArch64 user space addresses fit in 48 bits, which leaves
+//    16 bits of a plain 64-bit word for the tag.
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stack>
+#include <mutex>
+#include <optional>
+#include <chrono>
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+#include "MemoryReclamation.cpp"          // EpochDomain, HazardDomain (no main)
+
+constexpr size_t kCacheLine = 64;
+
+// 48-bit pointer + 16-bit ABA tag in one word
+template <typename Node>
+class TaggedPtr {
+public:
+    TaggedPtr() = default;
+    TaggedPtr(Node* node, uint16_t tag)
+        : bits_(reinterpret_cast<uintptr_t>(node) | (uint64_t(tag) << kTagShift)) {}
+
+    Node* get() const { return reinterpret_cast<Node*>(bits_ & kAddressMask); }
+    uint16_t tag() const { return uint16_t(bits_ >> kTagShift); }
+
+    // Same target, next tag: what a successful CAS installs
+    TaggedPtr next(Node* node) const { return TaggedPtr(node, uint16_t(tag() + 1)); }
+
+    bool operator==(const TaggedPtr&) const = default;
+
+private:
+    static constexpr int kTagShift = 48;
+    static constexpr uint64_t kAddressMask = (uint64_t{1} << kTagShift) - 1;
+
+    uint64_t bits_ = 0;
+};
+
+// Default reclamation for ConcurrentStack: none, popped nodes go to the spare list
+struct RecycleNodes {
+    struct Guard {
+        template <typename P, typename Projection>
+        P protect(size_t /*slot*/, const std::atomic<P>& src, Projection&&) {
+            return src.load(std::memory_order_acquire);
+        }
+    };
+
+    Guard guard() { return {}; }
+
+    static RecycleNodes& shared() {
+        static RecycleNodes none;
+        return none;
+    }
+};
+
+template <typename T, typename Reclaim = RecycleNodes>
+class ConcurrentStack {
+public:
+    // elimination_slots == 0 → plain Treiber stack
+    explicit ConcurrentStack(size_t elimination_slots = 16, Reclaim& reclaim = Reclaim::shared())
+        : reclaim_(reclaim), slots_(elimination_slots) {}
+
+    ConcurrentStack(const ConcurrentStack&) = delete;
+    ConcurrentStack& operator=(const ConcurrentStack&) = delete;
+
+    // No other thread may be using the stack any more
+    ~ConcurrentStack() {
+        for (Node* node = head_.load().get(); node;) {
+            Node* next = node->next.load(std::memory_order_relaxed);
+            node->value.reset();
+            delete node;
+            node = next;
+        }
+        for (Node* node = spare_.load().get(); node;) {
+            Node* next = node->next.load(std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        Node* node = kRecycle ? popNode(spare_) : nullptr;
+        if (!node) node = new Node;
+        node->value.emplace(std::forward<Args>(args)...);
+        push(node);
+    }
+
+    void push(const T& value) { emplace(value); }
+    void push(T&& value) { emplace(std::move(value)); }
+
+    bool try_pop(T& out) {
+        Node* node = pop();
+        if (!node) return false;
+        out = std::move(*node->value);
+        release(node);
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        std::optional<T> out;
+        Node* node = pop();
+        if (!node) return out;
+        out.emplace(std::move(*node->value));
+        release(node);
+        return out;
+    }
+
+    // Only a snapshot
+    bool empty() const { return head_.load(std::memory_order_relaxed).get() == nullptr; }
+
+    static constexpr size_t node_bytes() { return sizeof(Node); }
+
+    // How many push/pop pairs met in the elimination array so far
+    uint64_t eliminated() const {
+        uint64_t total = 0;
+        for (const auto& slot : slots_) total += slot.hits.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};           // atomic: a stale popper may read it
+        std::optional<T> value;
+    };
+
+    using Head = std::atomic<TaggedPtr<Node>>;
+
+    static constexpr bool kRecycle = std::is_same_v<Reclaim, RecycleNodes>;
+
+    // Slot states: kEmpty, kTaken, or the Node* a push parked there
+    static constexpr uintptr_t kEmpty = 0;
+    static constexpr uintptr_t kTaken = 1;
+    static constexpr int kParkSpins = 128;
+
+    struct alignas(kCacheLine) Slot {
+        std::atomic<uintptr_t> state{kEmpty};
+        std::atomic<uint64_t> hits{0};
+    };
+
+    static void pushNode(Head& head, Node* node) {
+        TaggedPtr<Node> old = head.load(std::memory_order_relaxed);
+        do {
+            node->next.store(old.get(), std::memory_order_relaxed);
+        } while (!head.compare_exchange_weak(old, old.next(node), std::memory_order_release,
+                                             std::memory_order_relaxed));
+    }
+
+    static Node* popNode(Head& head) {
+        TaggedPtr<Node> old = head.load(std::memory_order_acquire);
+        while (old.get()) {
+            Node* next = old.get()->next.load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(old, old.next(next), std::memory_order_acquire,
+                                           std::memory_order_acquire))
+                return old.get();
+        }
+        return nullptr;
+    }
+
+    void push(Node* node) {
+        TaggedPtr<Node> old = head_.load(std::memory_order_relaxed);
+        while (true) {
+            node->next.store(old.get(), std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(old, old.next(node), std::memory_order_release,
+                                            std::memory_order_relaxed))
+                return;
+            if (!slots_.empty() && parkForPop(node))
+                return;
+            old = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // The caller owns the returned node; its next may still be read by stale pops
+    Node* pop() {
+        auto guard = reclaim_.guard();
+        while (true) {
+            TaggedPtr<Node> old = guard.protect(0, head_, &TaggedPtr<Node>::get);
+            if (!old.get())
+                return nullptr;
+            Node* next = old.get()->next.load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(old, old.next(next), std::memory_order_acquire,
+                                            std::memory_order_relaxed))
+                return old.get();
+            if (!slots_.empty()) {
+                if (Node* node = takeParked())
+                    return node;
+            }
+        }
+    }
+
+    void release(Node* node) {
+        node->value.reset();
+        if constexpr (kRecycle)
+            pushNode(spare_, node);
+        else
+            reclaim_.retire(node);
+    }
+
+    // true: a pop took node
+    bool parkForPop(Node* node) {
+        Slot& slot = slots_[randomSlot()];
+        uintptr_t expected = kEmpty;
+        if (!slot.state.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node),
+                                                std::memory_order_release, std::memory_order_relaxed))
+            return false;
+
+        for (int i = 0; i < kParkSpins; i++) {
+            if (slot.state.load(std::memory_order_acquire) == kTaken) {
+                slot.state.store(kEmpty, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        // Nobody came: take the node back, unless a pop got it at the very last moment
+        expected = reinterpret_cast<uintptr_t>(node);
+        if (slot.state.compare_exchange_strong(expected, kEmpty, std::memory_order_relaxed))
+            return false;
+        slot.state.store(kEmpty, std::memory_order_relaxed);
+        return true;
+    }
+
+    Node* takeParked() {
+        Slot& slot = slots_[randomSlot()];
+        uintptr_t parked = slot.state.load(std::memory_order_acquire);
+        if (parked == kEmpty || parked == kTaken)
+            return nullptr;
+        if (!slot.state.compare_exchange_strong(parked, kTaken, std::memory_order_acquire,
+                                                std::memory_order_relaxed))
+            return nullptr;
+        slot.hits.fetch_add(1, std::memory_order_relaxed);
+        return reinterpret_cast<Node*>(parked);
+    }
+
+    size_t randomSlot() const {
+        static thread_local uint64_t x = 0x9E3779B97F4A7C15ULL ^ std::hash<std::thread::id>{}(std::this_thread::get_id());
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x % slots_.size();
+    }
+
+    Reclaim& reclaim_;
+    alignas(kCacheLine) Head head_{};
+    alignas(kCacheLine) Head spare_{};              // RecycleNodes: popped nodes, reused by push
+    std::vector<Slot> slots_;
+
+    static_assert(std::atomic<TaggedPtr<Node>>::is_always_lock_free);
+};
+
+// Reference: what the free-lists use today
+template <typename T>
+class MutexStack {
+public:
+    void push(T value) {
+        std::lock_guard lock(mtx_);
+        stack_.push(std::move(value));
+    }
+
+    bool try_pop(T& out) {
+        std::lock_guard lock(mtx_);
+        if (stack_.empty()) return false;
+        out = std::move(stack_.top());
+        stack_.pop();
+        return true;
+    }
+
+private:
+    std::mutex mtx_;
+    std::stack<T> stack_;
+};
+
+// **************** Benchmark ***************
+
+// Free-list pattern: every thread pops a buffer (or makes one if the list is empty),
+// "uses" it, and pushes it back, so pushes and pops arrive in equal numbers.
+// Mops/s = (pushes + pops) per microsecond over all threads.
+
+template <typename Stack>
+double runFreeList(Stack& stack, int threads, long ops_per_thread) {
+    std::vector<std::thread> workers;
+    std::atomic<bool> go{false};
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            uint64_t buffer = 0;
+            for (long i = 0; i < ops_per_thread / 2; i++) {
+                if (!stack.try_pop(buffer)) buffer = uint64_t(t) << 32 | uint64_t(i);
+                stack.push(buffer);
+            }
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers) w.join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return threads * ops_per_thread / ms / 1000;
+}
+
+void benchStacks(int max_threads) {
+    constexpr long kOpsPerThread = 1000000;
+
+    std::cout << "threads   mutex+std::stack   Treiber   Treiber+elimination   (Mops/s)   eliminated\n";
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        MutexStack<uint64_t> locked;
+        ConcurrentStack<uint64_t> treiber(0);
+        ConcurrentStack<uint64_t> eliminating(16);
+
+        double a = runFreeList(locked, threads, kOpsPerThread);
+        double b = runFreeList(treiber, threads, kOpsPerThread);
+        double c = runFreeList(eliminating, threads, kOpsPerThread);
+        std::cout << std::setw(7) << threads << std::fixed << std::setprecision(2) << std::setw(19) << a
+                  << std::setw(10) << b << std::setw(22) << c << std::setw(24) << eliminating.eliminated() << '\n';
+    }
+}
+
+// **************** Reclamation under a stalled reader ***************
+
+// kWriters threads push/pop a ConcurrentStack that retires every popped node to the domain.
+// In the "stalled" runs one more thread takes a guard for the middle kStallMs and sleeps
+// with it (a preempted or page-faulting reader), then lets go. The pending count is sampled
+// every millisecond; peak KB = peak unreclaimed nodes x node size.
+//  - EpochDomain: the pinned reader stops the epoch, every node popped meanwhile piles up
+//  - EpochDomain with max_pending: memory stays bounded, writers wait out the stall instead
+//  - HazardDomain: the reader keeps only what it protects alive (nothing, here)
+
+template <typename Domain>
+void runStalled(const char* name, typename Domain::Options options, bool stall) {
+    constexpr int kWriters = 4;
+    constexpr auto kRun = std::chrono::milliseconds(600);
+    constexpr auto kStallStart = std::chrono::milliseconds(150);
+    constexpr auto kStall = std::chrono::milliseconds(300);
+
+    options.measure = true;
+    Domain domain(options);
+    uint64_t peak = 0;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> ops{0};
+    {
+        ConcurrentStack<uint64_t, Domain> stack(16, domain);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kWriters; t++) {
+            threads.emplace_back([&] {
+                uint64_t local = 0, value = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    stack.push(local);
+                    stack.try_pop(value);
+                    local += 2;
+                }
+                ops += local;
+            });
+        }
+        if (stall) {
+            threads.emplace_back([&] {
+                std::this_thread::sleep_for(kStallStart);
+                auto guard = domain.guard();
+                std::this_thread::sleep_for(kStall);
+            });
+        }
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - start < kRun) {
+            peak = std::max(peak, domain.stats().pending());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        stop = true;
+        for (auto& t : threads) t.join();
+    }
+
+    ReclaimStats stats = domain.stats();
+    std::cout << std::left << std::setw(26) << name << std::right << std::setw(5) << (stall ? "yes" : "no")
+              << std::fixed << std::setprecision(2) << std::setw(9) << ops / 1e3 / kRun.count()
+              << std::setw(10) << peak << std::setw(10) << peak * ConcurrentStack<uint64_t>::node_bytes() / 1024
+              << std::setprecision(1) << std::setw(12) << stats.avg_latency_us << std::setw(12) << stats.max_latency_us
+              << std::setw(8) << stats.writer_waits << '\n';
+}
+
+void benchReclaim() {
+    std::cout << "domain                    stall   Mops/s   peak unreclaimed   reclaim latency us   writer\n"
+              << "                                             nodes        KB        avg         max    waits\n";
+    for (bool stall : {false, true}) {
+        runStalled<EpochDomain>("epoch", {}, stall);
+        runStalled<EpochDomain>("epoch, max_pending 4096", {.max_pending = 4096}, stall);
+        runStalled<HazardDomain>("hazard pointers", {}, stall);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "reclaim") {
+        benchReclaim();
+        return 0;
+    }
+    benchStacks(mode.empty() ? 64 : std::stoi(mode));
+    return 0;
+}
@@ -24,60 +24,10 @@
 
 // So we can implement a RequestScheduler, where it stores a callbakc registry and maintains this .
 
-// ****************** FIrst version ****************
-
-// How to schedule event call back.
-
-class EventRegistry{
-
-    std::mutex mtx;
-    std::condition_variable cv;
-    std::queue<std::function<void>> callbackRegistry;
-    bool eventStarted{false};
-    std::thread eventThread;
-public:
-
-    EventRegistry(){
-        eventThread = std::thread([this](){
-            while(true){
-                std::unique_lock<std::mutex> lock(mtx);
-                cv.wait(lock, [this](){
-                    return !eventStarted && !callbackRegistry.empty();
-                });
-
-                while(!callbackRegistry.empty()){
-                    std::function<void> cb = callbackRegistry.front();
-                    callbackRegistry.pop();
-                    cb(); // may be execute in some different thread
-                }
-            }
-        });
-    }
-
-    void registerCallback(std::function<void> cb){
-        std::unique_lock<std::mutex> lock(mtx);
-        if(eventStarted){
-            callbackRegistry.push(cb);
-        } else {
-            cb();
-        }
-    }
-
-    void setEventStarted(){
-        std::unique_lock<std::mutex> lock(mtx);
-        eventStarted = true;
-    }
-
-    void setEventStopped(){
-        {
-            std::unique_lock<std::mutex> lock(mtx);
-            eventStarted = false;
-        }
-        cv.notify_one();
-    }
-};
-
-// **************** Event Registry CallBack Imporved Version ***************
+// g++ -std=c++20 -O2 -pthread EventRegistryCallBack.cpp
+//   ./a.out        → the timeline above: f1, f2 held back by the event, f3 runs right away
+//   ./a.out trace  → 3 events with callbacks registered during and after each,
+//                    writes event_registry_trace.json (chrome://tracing / ui.perfetto.dev)
 
 #include <iostream>
 #include <functional>
@@ -85,7 +35,76 @@ public:
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+
+// ****************** FIrst version ****************
+
+// How to schedule event call back.
+// Kept as notes: std::function<void> needs to be std::function<void()>, and the
+// queued callbacks run with mtx held.
+
+// class EventRegistry{
+
+//     std::mutex mtx;
+//     std::condition_variable cv;
+//     std::queue<std::function<void>> callbackRegistry;
+//     bool eventStarted{false};
+//     std::thread eventThread;
+// public:
+
+//     EventRegistry(){
+//         eventThread = std::thread([this](){
+//             while(true){
+//                 std::unique_lock<std::mutex> lock(mtx);
+//                 cv.wait(lock, [this](){
+//                     return !eventStarted && !callbackRegistry.empty();
+//                 });
+
+//                 while(!callbackRegistry.empty()){
+//                     std::function<void> cb = callbackRegistry.front();
+//                     callbackRegistry.pop();
+//                     cb(); // may be execute in some different thread
+//                 }
+//             }
+//         });
+//     }
+
+//     void registerCallback(std::function<void> cb){
+//         std::unique_lock<std::mutex> lock(mtx);
+//         if(eventStarted){
+//             callbackRegistry.push(cb);
+//         } else {
+//             cb();
+//         }
+//     }
+
+//     void setEventStarted(){
+//         std::unique_lock<std::mutex> lock(mtx);
+//         eventStarted = true;
+//     }
+
+//     void setEventStopped(){
+//         {
+//             std::unique_lock<std::mutex> lock(mtx);
+//             eventStarted = false;
+//         }
+//         cv.notify_one();
+//     }
+// };
+
+// **************** Event Registry CallBack Imporved Version ***************
+
+// Own namespace: the thread pool version below keeps the EventRegistry name
+namespace improved {
 
 class EventRegistry {
 private:
@@ -168,26 +187,140 @@ private:
     }
 };
 
+} // namespace improved
+
 
 // **************** With Thread Pool ***************
 
+// Timeline tracing, same design and output as TaskTracer in thread_pool.cpp:
+// per-thread rings (single writer, no shared lock per event), dumped as Chrome trace JSON.
+//   Tracer::start(); ... registry.reg_cb(cb, "label"); ... Tracer::stop(); Tracer::dump("trace.json");
+// A callback registered during an event shows as a flow arrow from reg_cb to the worker
+// that ran it, so the time it spent held back by the event is visible.
+// Call dump() after stop(): it does not guard against rings being overwritten under it.
+class Tracer {
+public:
+    enum class Phase : uint8_t { Enqueue, Begin, End, Instant };
 
+    static void start(size_t eventsPerThread = size_t{1} << 16) {
+        capacity_ = std::bit_ceil(std::max<size_t>(eventsPerThread, 2));
+        startNs_ = nowNs();
+        enabled_.store(true, std::memory_order_release);
+    }
 
+    static void stop() { enabled_.store(false, std::memory_order_release); }
 
-#include <iostream>
-#include <functional>
-#include <queue>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <vector>
-#include <atomic>
-#include <future>
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // 0 when tracing is off; pass it back to record() for Begin/End
+    static uint64_t enqueued(const char* label) {
+        if (!enabled()) return 0;
+        Buffer& buffer = local();
+        uint64_t id = (uint64_t(buffer.tid) << 40) | ++buffer.nextId;
+        buffer.record(Phase::Enqueue, id, label);
+        return id;
+    }
+
+    static void record(Phase phase, uint64_t id, const char* label) {
+        if (id != 0 || (phase == Phase::Instant && enabled())) local().record(phase, id, label);
+    }
+
+    static bool dump(const std::string& path) {
+        std::ofstream os(path);
+        std::lock_guard lock(registryMtx_);
+        bool first = true;
+        auto sep = [&]() { os << (first ? "\n" : ",\n"); first = false; };
+        auto ts = [](uint64_t ns) { return double(ns - std::min(ns, startNs_.load())) / 1000; };
+
+        os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        for (auto& buffer : buffers_) {
+            std::string common = ",\"pid\":1,\"tid\":" + std::to_string(buffer->tid);
+            uint64_t end = buffer->head.load(std::memory_order_acquire);
+            for (uint64_t i = end - std::min<uint64_t>(end, buffer->mask + 1); i < end; i++) {
+                const Event& e = buffer->events[i & buffer->mask];
+                if (e.ns < startNs_) continue;
+                const char* name = e.label ? e.label : "callback";
+                sep();
+                switch (e.phase) {
+                case Phase::Enqueue:
+                    os << "{\"name\":\"reg_cb " << name << "\",\"ph\":\"X\",\"dur\":0.001,\"ts\":" << ts(e.ns) << common
+                       << "},\n{\"name\":\"queued\",\"cat\":\"cb\",\"ph\":\"s\",\"id\":" << e.id << ",\"ts\":" << ts(e.ns) << common << "}";
+                    break;
+                case Phase::Begin:
+                    os << "{\"name\":\"" << name << "\",\"ph\":\"B\",\"ts\":" << ts(e.ns) << common
+                       << "},\n{\"name\":\"queued\",\"cat\":\"cb\",\"ph\":\"f\",\"bp\":\"e\",\"id\":" << e.id << ",\"ts\":" << ts(e.ns) << common << "}";
+                    break;
+                case Phase::End:
+                    os << "{\"name\":\"" << name << "\",\"ph\":\"E\",\"ts\":" << ts(e.ns) << common << "}";
+                    break;
+                case Phase::Instant:
+                    os << "{\"name\":\"" << name << "\",\"ph\":\"i\",\"s\":\"g\",\"ts\":" << ts(e.ns) << common << "}";
+                    break;
+                }
+            }
+        }
+        os << "\n]}\n";
+        return bool(os);
+    }
+
+private:
+    struct Event {
+        uint64_t ns;
+        uint64_t id;
+        const char* label;
+        Phase phase;
+    };
+
+    struct Buffer {
+        std::unique_ptr<Event[]> events;
+        size_t mask;
+        std::atomic<uint64_t> head{0};
+        uint64_t nextId = 0;
+        uint32_t tid;
+
+        void record(Phase phase, uint64_t id, const char* label) {
+            uint64_t h = head.load(std::memory_order_relaxed);
+            events[h & mask] = {nowNs(), id, label, phase};
+            head.store(h + 1, std::memory_order_release);
+        }
+    };
+
+    static uint64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static Buffer& local() {
+        static thread_local Buffer* buffer = nullptr;
+        if (!buffer) {
+            auto fresh = std::make_unique<Buffer>();
+            fresh->events = std::make_unique<Event[]>(capacity_);
+            fresh->mask = capacity_ - 1;
+            std::lock_guard lock(registryMtx_);
+            fresh->tid = uint32_t(buffers_.size() + 1);
+            buffer = fresh.get();
+            buffers_.push_back(std::move(fresh));
+        }
+        return *buffer;
+    }
+
+    inline static std::atomic<bool> enabled_{false};
+    inline static std::atomic<size_t> capacity_{size_t{1} << 16};
+    inline static std::atomic<uint64_t> startNs_{0};
+    inline static std::mutex registryMtx_;
+    inline static std::vector<std::unique_ptr<Buffer>> buffers_;
+};
 
 class ThreadPool {
 private:
+    struct Job {
+        std::function<void()> func;
+        uint64_t traceId = 0;
+        const char* label = nullptr;
+    };
+
     std::vector<std::thread> workers_;
-    std::queue<std::function<void()>> tasks_;
+    std::queue<Job> tasks_;
     std::mutex mtx_;
     std::condition_variable cv_;
     bool stop_{false};
@@ -197,30 +330,33 @@ public:
         for (size_t i = 0; i < numThreads; ++i) {
             workers_.emplace_back([this]() {
                 while (true) {
-                    std::function<void()> task;
+                    Job job;
                     {
                         std::unique_lock lock(mtx_);
                         cv_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
                         if (stop_ && tasks_.empty()) return;
-                        task = std::move(tasks_.front());
+                        job = std::move(tasks_.front());
                         tasks_.pop();
                     }
+                    Tracer::record(Tracer::Phase::Begin, job.traceId, job.label);
                     try {
-                        task();
+                        job.func();
                     } catch (const std::exception& e) {
                         std::cerr << "Task exception: " << e.what() << "\n";
                     } catch (...) {
                         std::cerr << "Unknown task exception\n";
                     }
+                    Tracer::record(Tracer::Phase::End, job.traceId, job.label);
                 }
             });
         }
     }
 
-    void enqueue(std::function<void()> func) {
+    // traceId: from Tracer::enqueued(), 0 to record nothing
+    void enqueue(std::function<void()> func, uint64_t traceId = 0, const char* label = nullptr) {
         {
             std::lock_guard lock(mtx_);
-            tasks_.push(std::move(func));
+            tasks_.push({std::move(func), traceId, label});
         }
         cv_.notify_one();
     }
@@ -239,9 +375,15 @@ public:
 
 class EventRegistry {
 private:
+    struct Callback {
+        std::function<void()> cb;
+        uint64_t traceId;
+        const char* label;
+    };
+
     std::mutex mtx_;
     std::condition_variable cv_;
-    std::queue<std::function<void()>> callbackQueue_;
+    std::queue<Callback> callbackQueue_;
     bool eventInProgress_{false};
     std::atomic<bool> stop_{false};
     std::thread monitorThread_;
@@ -253,31 +395,38 @@ public:
         monitorThread_ = std::thread([this]() { monitor(); });
     }
 
-    void reg_cb(std::function<void()> cb) {
+    // label: shown in the Tracer output, must outlive the dump (string literal)
+    void reg_cb(std::function<void()> cb, const char* label = nullptr) {
+        uint64_t traceId = Tracer::enqueued(label);
         std::unique_lock lock(mtx_);
         if (eventInProgress_) {
-            callbackQueue_.push(cb);
+            callbackQueue_.push({std::move(cb), traceId, label});
         } else {
             lock.unlock();
-            threadPool_.enqueue(std::move(cb)); // Execute immediately in pool
+            threadPool_.enqueue(std::move(cb), traceId, label); // Execute immediately in pool
         }
     }
 
     void startEvent() {
         std::lock_guard lock(mtx_);
         eventInProgress_ = true;
+        Tracer::record(Tracer::Phase::Instant, 0, "event started");
     }
 
     void stopEvent() {
         {
             std::lock_guard lock(mtx_);
             eventInProgress_ = false;
+            Tracer::record(Tracer::Phase::Instant, 0, "event stopped");
         }
         cv_.notify_one();
     }
 
     void shutdown() {
-        stop_ = true;
+        {
+            std::lock_guard lock(mtx_);     // the monitor can't miss it between check and wait
+            stop_ = true;
+        }
         cv_.notify_one();
         if (monitorThread_.joinable()) monitorThread_.join();
         // threadPool_ destructor handles stopping its threads
@@ -292,17 +441,87 @@ private:
         while (true) {
             std::unique_lock lock(mtx_);
             cv_.wait(lock, [this]() {
-                return !eventInProgress_ || stop_;
+                return (!eventInProgress_ && !callbackQueue_.empty()) || stop_;    // not just "no event": that spins
             });
             if (stop_) break;
 
             while (!callbackQueue_.empty()) {
-                auto cb = callbackQueue_.front();
+                auto item = std::move(callbackQueue_.front());
                 callbackQueue_.pop();
                 lock.unlock();
-                threadPool_.enqueue(std::move(cb));
+                threadPool_.enqueue(std::move(item.cb), item.traceId, item.label);
                 lock.lock();
             }
         }
     }
 };
+
+// The timeline from the question. Lines are printed under one mutex, ms since start.
+void demo() {
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    std::mutex outMtx;
+    auto log = [&](const std::string& what) {
+        std::lock_guard lock(outMtx);
+        std::cout << std::setw(4) << duration_cast<milliseconds>(steady_clock::now() - start).count()
+                  << " ms  " << what << '\n';
+    };
+    std::atomic<int> ran{0};
+    auto callback = [&](std::string name) {
+        return [&, name]() { log(name + " executed"); ran++; };
+    };
+
+    EventRegistry registry(2);
+    registry.startEvent();
+    log("event started");
+    registry.reg_cb(callback("f1"), "f1");
+    log("U1: reg_cb(f1)");
+    std::this_thread::sleep_for(milliseconds(20));
+    registry.reg_cb(callback("f2"), "f2");
+    log("U2: reg_cb(f2)");
+    std::this_thread::sleep_for(milliseconds(20));
+    log("event completed");
+    registry.stopEvent();
+    std::this_thread::sleep_for(milliseconds(20));
+    log("U3: reg_cb(f3)");
+    registry.reg_cb(callback("f3"), "f3");
+    while (ran.load() < 3) std::this_thread::yield();
+}
+
+// 3 events, 100 callbacks registered during each (held back) and 100 after it
+void traceEvents() {
+    constexpr int kRounds = 3, kPerPhase = 100;
+    std::atomic<int> ran{0};
+    auto work = [&ran]() {
+        auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+        while (std::chrono::steady_clock::now() < until) {}
+        ran++;
+    };
+
+    Tracer::start();
+    {
+        EventRegistry registry(4);
+        for (int round = 0; round < kRounds; round++) {
+            registry.startEvent();
+            for (int i = 0; i < kPerPhase; i++) registry.reg_cb(work, "during event");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            registry.stopEvent();
+            for (int i = 0; i < kPerPhase; i++) registry.reg_cb(work, "after event");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        while (ran.load() < kRounds * kPerPhase * 2) std::this_thread::yield();
+    }
+    Tracer::stop();
+    bool ok = Tracer::dump("event_registry_trace.json");
+    std::cout << ran.load() << " callbacks, " << (ok ? "written to" : "failed to write")
+              << " event_registry_trace.json\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "trace")
+        traceEvents();
+    else
+        demo();
+    return 0;
+}
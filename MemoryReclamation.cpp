@@ -0,0 +1,412 @@
+// No main: included by ConcurrentStack.cpp and ConcurrentQueue.cpp, build those.
+
+// **************** Safe memory reclamation ***************
+
+// A lock-free structure can't delete a node the moment it unlinks it: another thread may
+// have loaded a pointer to that node just before and still be reading it. The node has to
+// be retired instead, and deleted once no thread can hold a reference any more.
+//
+// Two domains with the same API:
+//
+//   auto guard = domain.guard();                  // RAII, brackets every read of shared nodes
+//   Node* node = guard.protect(0, head_);         // load a pointer that stays valid
+//   ...                                           // until guard is destroyed
+//   domain.retire(node);                          // after unlinking: delete once safe
+//
+// EpochDomain (epoch-based reclamation)
+//  - guard() pins the thread to the current global epoch, protect() is a plain load
+//  - a node retired in epoch e is deleted once the global epoch reaches e + 2; the epoch
+//    only advances when every pinned thread has seen the current one
+//  - cheapest reads (one store + fence per guard, nothing per pointer), but one stalled
+//    reader stops all reclamation: garbage grows without bound, unless Options::max_pending
+//    is set, in which case retire() waits for the reader instead (bounded memory, blocked
+//    writers)
+// HazardDomain (hazard pointers)
+//  - protect() publishes the pointer in one of the thread's kHazardsPerThread slots and
+//    re-checks the source, a retired node is deleted once no slot points at it
+//  - a store + fence per protected pointer, but a stalled reader only keeps the few nodes
+//    it protects alive: a thread's retire list stays below max(scan_threshold, 2 x all
+//    hazard slots in use) plus twice what those hazards pin
+//
+// Both keep retire lists per thread (no shared list to contend on), scanned when they reach
+// Options::scan_threshold (or twice what the last scan had to leave). Garbage of an exited thread is picked up by the next thread that
+// gets its index, or freed when the domain is destroyed.
+
+// Q: Why protect(slot, src) instead of protect(ptr)?
+// A: Publishing a pointer you already loaded is too late, it may have been retired and
+//    scanned in between. protect() loads, publishes, and re-loads src until both agree.
+//    The optional projection lets src hold something else than a raw pointer (a tagged
+//    pointer, for example).
+
+// Q: Can guards nest?
+// A: Epoch guards can (only the outermost pins). A thread may hold only one HazardDomain
+//    guard per domain at a time, the slot numbers are the caller's to pick.
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+// **************** Thread records ***************
+
+constexpr size_t kMaxReclaimThreads = 256;
+
+// Small process-wide index of the calling thread, its record in every domain.
+// Taken on first use, handed back when the thread exits.
+class ReclaimThreadIndex {
+public:
+    static size_t current() {
+        thread_local Holder holder;
+        return holder.index;
+    }
+
+    // Records [0, high_water()) may be in use
+    static size_t high_water() { return high_water_.load(); }
+
+private:
+    struct Holder {
+        size_t index = take();
+        ~Holder() { used_[index].store(false, std::memory_order_release); }
+    };
+
+    static size_t take() {
+        for (size_t i = 0; i < kMaxReclaimThreads; i++) {
+            bool expected = false;
+            if (used_[i].load(std::memory_order_relaxed) ||
+                !used_[i].compare_exchange_strong(expected, true, std::memory_order_acquire))
+                continue;
+            size_t high = high_water_.load();
+            while (high < i + 1 && !high_water_.compare_exchange_weak(high, i + 1)) {}
+            return i;
+        }
+        throw std::runtime_error("more than kMaxReclaimThreads threads use memory reclamation");
+    }
+
+    static inline std::atomic<bool> used_[kMaxReclaimThreads]{};
+    static inline std::atomic<size_t> high_water_{0};
+};
+
+struct ReclaimStats {
+    uint64_t retired = 0;
+    uint64_t reclaimed = 0;
+    uint64_t writer_waits = 0;          // EpochDomain with max_pending: retire() calls that waited
+    double avg_latency_us = 0;          // retire → delete, Options::measure only
+    double max_latency_us = 0;
+
+    uint64_t pending() const { return retired - reclaimed; }
+};
+
+struct Retired {
+    void* ptr;
+    void (*deleter)(void*);
+    uint64_t epoch;                     // EpochDomain: global epoch when retired
+    int64_t retired_ns;                 // Options::measure only
+};
+
+inline int64_t reclaimNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One thread's garbage. Only the owning thread touches items_ and writes the counters,
+// stats() reads the counters from anywhere.
+class RetireList {
+public:
+    void add(void* ptr, void (*deleter)(void*), uint64_t epoch, bool measure) {
+        items_.push_back({ptr, deleter, epoch, measure ? reclaimNowNs() : 0});
+        bump(retired_, 1);
+    }
+
+    size_t size() const { return items_.size(); }
+
+    // Scan at threshold, or once the list doubled since a scan that couldn't free much
+    // (otherwise a stalled reader makes every retire rescan the whole list)
+    bool due(size_t threshold) const { return items_.size() >= std::max(threshold, next_scan_); }
+
+    // Deletes every item can_free(item) says is safe
+    template <typename CanFree>
+    void reclaim(CanFree&& can_free, bool measure) {
+        // A deleter may retire more nodes, so walk a moved-out copy
+        scratch_.swap(items_);
+        int64_t now = measure ? reclaimNowNs() : 0;
+        uint64_t freed = 0, latency_sum = 0, latency_max = latency_max_.load(std::memory_order_relaxed);
+        for (const Retired& item : scratch_) {
+            if (!can_free(item)) {
+                items_.push_back(item);
+                continue;
+            }
+            item.deleter(item.ptr);
+            freed++;
+            if (measure) {
+                uint64_t latency = uint64_t(now - item.retired_ns);
+                latency_sum += latency;
+                latency_max = std::max(latency_max, latency);
+            }
+        }
+        scratch_.clear();
+        next_scan_ = 2 * items_.size();
+        bump(reclaimed_, freed);
+        bump(latency_sum_, latency_sum);
+        latency_max_.store(latency_max, std::memory_order_relaxed);
+    }
+
+    void countWait() { bump(writer_waits_, 1); }
+
+    void addTo(ReclaimStats& stats, uint64_t& latency_sum_ns, uint64_t& latency_max_ns) const {
+        stats.retired += retired_.load(std::memory_order_relaxed);
+        stats.reclaimed += reclaimed_.load(std::memory_order_relaxed);
+        stats.writer_waits += writer_waits_.load(std::memory_order_relaxed);
+        latency_sum_ns += latency_sum_.load(std::memory_order_relaxed);
+        latency_max_ns = std::max(latency_max_ns, latency_max_.load(std::memory_order_relaxed));
+    }
+
+    ~RetireList() {
+        for (const Retired& item : items_) item.deleter(item.ptr);
+    }
+
+private:
+    // Single writer: no locked read-modify-write needed
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::vector<Retired> items_;
+    std::vector<Retired> scratch_;
+    size_t next_scan_ = 0;
+    std::atomic<uint64_t> retired_{0};
+    std::atomic<uint64_t> reclaimed_{0};
+    std::atomic<uint64_t> writer_waits_{0};
+    std::atomic<uint64_t> latency_sum_{0};
+    std::atomic<uint64_t> latency_max_{0};
+};
+
+template <typename T>
+void deleteRetired(void* ptr) {
+    delete static_cast<T*>(ptr);
+}
+
+struct IdentityProjection {
+    template <typename P>
+    P operator()(P p) const { return p; }
+};
+
+template <typename Records>
+ReclaimStats collectStats(const Records& records) {
+    ReclaimStats stats;
+    uint64_t latency_sum = 0, latency_max = 0;
+    for (size_t i = 0; i < kMaxReclaimThreads; i++) records[i].garbage.addTo(stats, latency_sum, latency_max);
+    if (stats.reclaimed) stats.avg_latency_us = latency_sum / 1e3 / stats.reclaimed;
+    stats.max_latency_us = latency_max / 1e3;
+    return stats;
+}
+
+// **************** EpochDomain ***************
+
+class EpochDomain {
+    struct Record;
+
+public:
+    struct Options {
+        size_t scan_threshold = 64;     // retire list length that triggers a reclaim pass
+        size_t max_pending = 0;         // per thread; 0 = unbounded, else retire() waits
+        bool measure = false;           // time retire → delete
+    };
+
+    explicit EpochDomain(Options options) : options_(options), records_(new Record[kMaxReclaimThreads]) {}
+    EpochDomain() : EpochDomain(Options{}) {}
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Shared by every structure that doesn't bring its own domain
+    static EpochDomain& shared() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& domain) : record_(domain.record()) {
+            if (record_.nesting++ == 0) {
+                record_.epoch.store(domain.epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);     // pin before any read
+            }
+        }
+
+        ~Guard() {
+            if (--record_.nesting == 0) record_.epoch.store(kQuiescent, std::memory_order_release);
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        // Pinned: everything reachable now stays allocated until the guard goes away
+        template <typename P, typename Projection = IdentityProjection>
+        P protect(size_t /*slot*/, const std::atomic<P>& src, Projection&& = {}) {
+            return src.load(std::memory_order_acquire);
+        }
+
+        void clear(size_t /*slot*/) {}
+
+    private:
+        Record& record_;
+    };
+
+    Guard guard() { return Guard(*this); }
+
+    template <typename T>
+    void retire(T* ptr) { retire(ptr, &deleteRetired<T>); }
+
+    void retire(void* ptr, void (*deleter)(void*)) {
+        Record& self = record();
+        self.garbage.add(ptr, deleter, epoch_.load(std::memory_order_relaxed), options_.measure);
+        bool over = options_.max_pending && self.garbage.size() >= options_.max_pending;
+        if (!over && !self.garbage.due(options_.scan_threshold)) return;
+
+        reclaim(self);
+        // Bounded garbage: wait for the stalled reader. Not while pinned ourselves,
+        // the epoch could never move.
+        if (!over || self.garbage.size() < options_.max_pending || self.nesting) return;
+        self.garbage.countWait();
+        while (self.garbage.size() >= options_.max_pending) {
+            std::this_thread::yield();
+            reclaim(self);
+        }
+    }
+
+    ReclaimStats stats() const { return collectStats(records_); }
+
+private:
+    static constexpr uint64_t kQuiescent = 0;
+
+    struct alignas(64) Record {
+        std::atomic<uint64_t> epoch{kQuiescent};        // pinned epoch
+        int nesting = 0;
+        RetireList garbage;
+    };
+
+    Record& record() { return records_[ReclaimThreadIndex::current()]; }
+
+    // The epoch may move from e to e + 1 once no thread is pinned to an older one
+    void tryAdvance() {
+        uint64_t epoch = epoch_.load();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (size_t i = 0, n = ReclaimThreadIndex::high_water(); i < n; i++) {
+            uint64_t pinned = records_[i].epoch.load(std::memory_order_acquire);
+            if (pinned != kQuiescent && pinned != epoch) return;
+        }
+        epoch_.compare_exchange_strong(epoch, epoch + 1);
+    }
+
+    void reclaim(Record& self) {
+        tryAdvance();
+        uint64_t safe = epoch_.load(std::memory_order_acquire);
+        self.garbage.reclaim([safe](const Retired& item) { return item.epoch + 2 <= safe; }, options_.measure);
+    }
+
+    Options options_;
+    alignas(64) std::atomic<uint64_t> epoch_{1};
+    std::unique_ptr<Record[]> records_;
+};
+
+// **************** HazardDomain ***************
+
+class HazardDomain {
+    struct Record;
+
+public:
+    static constexpr size_t kHazardsPerThread = 4;
+
+    struct Options {
+        size_t scan_threshold = 64;     // at least 2 x the hazard slots in use
+        bool measure = false;
+    };
+
+    explicit HazardDomain(Options options) : options_(options), records_(new Record[kMaxReclaimThreads]) {}
+    HazardDomain() : HazardDomain(Options{}) {}
+
+    HazardDomain(const HazardDomain&) = delete;
+    HazardDomain& operator=(const HazardDomain&) = delete;
+
+    static HazardDomain& shared() {
+        static HazardDomain domain;
+        return domain;
+    }
+
+    class Guard {
+    public:
+        explicit Guard(HazardDomain& domain) : record_(domain.record()) {}
+
+        ~Guard() {
+            for (auto& hazard : record_.hazards) hazard.store(nullptr, std::memory_order_release);
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        template <typename P, typename Projection = IdentityProjection>
+        P protect(size_t slot, const std::atomic<P>& src, Projection&& projection = {}) {
+            P value = src.load(std::memory_order_relaxed);
+            while (true) {
+                record_.hazards[slot].store(std::invoke(projection, value), std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);     // publish before re-checking
+                P again = src.load(std::memory_order_acquire);
+                if (again == value) return value;
+                value = again;
+            }
+        }
+
+        void clear(size_t slot) { record_.hazards[slot].store(nullptr, std::memory_order_release); }
+
+    private:
+        Record& record_;
+    };
+
+    Guard guard() { return Guard(*this); }
+
+    template <typename T>
+    void retire(T* ptr) { retire(ptr, &deleteRetired<T>); }
+
+    void retire(void* ptr, void (*deleter)(void*)) {
+        Record& self = record();
+        self.garbage.add(ptr, deleter, 0, options_.measure);
+        size_t threads = ReclaimThreadIndex::high_water();
+        if (self.garbage.due(std::max(options_.scan_threshold, 2 * kHazardsPerThread * threads)))
+            reclaim(self, threads);
+    }
+
+    ReclaimStats stats() const { return collectStats(records_); }
+
+private:
+    struct alignas(64) Record {
+        std::atomic<const void*> hazards[kHazardsPerThread]{};
+        RetireList garbage;
+        std::vector<const void*> protected_;            // scratch for reclaim()
+    };
+
+    Record& record() { return records_[ReclaimThreadIndex::current()]; }
+
+    void reclaim(Record& self, size_t threads) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto& hazards = self.protected_;
+        hazards.clear();
+        for (size_t i = 0; i < threads; i++) {
+            for (auto& hazard : records_[i].hazards) {
+                if (const void* p = hazard.load(std::memory_order_acquire)) hazards.push_back(p);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+        self.garbage.reclaim([&](const Retired& item) {
+            return !std::binary_search(hazards.begin(), hazards.end(), static_cast<const void*>(item.ptr));
+        }, options_.measure);
+    }
+
+    Options options_;
+    std::unique_ptr<Record[]> records_;
+};
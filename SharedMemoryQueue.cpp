@@ -0,0 +1,751 @@
+// g++ -std=c++20 -O2 -pthread SharedMemoryQueue.cpp
+//   ./a.out                       → messages/s and latency: shared-memory queue vs Unix domain socket
+//   ./a.out crash                 → consumer / producer killed mid-message, then replaced
+//   ./a.out produce NAME [count] [bytes]  /  ./a.out consume NAME   → two separate processes
+
+// **************** Shared-memory queue ***************
+
+// A BoundedBlockingQueue for two processes on the same host: one producer process, one
+// consumer process, talking through a named POSIX shared-memory segment (/dev/shm/NAME)
+// instead of a socket. A socket message costs a write() and a read() syscall and two
+// copies (user → kernel → user); here the producer writes the record straight into the
+// segment and the consumer reads it where it lies.
+//
+// Layout: a Header (indices, futex words, attached pids), then a power-of-two byte ring.
+// Records are variable length, 8-byte aligned: {uint32 size, uint32 kind} + payload. A
+// record that doesn't fit before the end of the ring is preceded by a wrap marker and
+// starts at offset 0, so a payload is always contiguous (fixed-size records are just
+// records that all have the same size: push(const T&) / as<T>()).
+//  - head / tail are free-running byte positions, each written by one side only (SPSC,
+//    same scheme as SpscRing in producer_consumer.cpp), tail is published after the
+//    payload is written, head after the consumer is done with the payload
+//  - blocking: the waiting side announces itself in a flag and sleeps in FUTEX_WAIT (not
+//    FUTEX_PRIVATE: the futex word is in shared memory, the kernel keys it by page);
+//    the other side does FUTEX_WAKE only if the flag is set, so a queue that is neither
+//    empty nor full makes no syscall at all
+//
+// Crash recovery: both sides register their pid in the header.
+//  - a producer dying mid-record never published it (tail wasn't moved), the consumer sees
+//    every complete record, then ShmStatus::PeerDead instead of blocking forever
+//  - a consumer dying while reading a record never released it (head wasn't moved), so
+//    the next consumer gets it again: at-least-once delivery. A producer blocked on a full
+//    ring gets ShmStatus::PeerDead
+//  - a new process attaches in the dead one's place and carries on from head / tail
+// Waits sleep in slices of kPeerCheck and check the peer's pid between slices (a zombie
+// counts as dead). A recycled pid would look alive: good enough for a supervisor that
+// restarts its workers right away.
+
+// Q: Why one producer and one consumer per segment?
+// A: With several processes per side a crash can happen between claiming space and
+//    publishing it, and the others would wait on that hole forever. One writer per index
+//    keeps "everything before tail is complete" true at every instant. Use a segment per
+//    producer for fan-in.
+
+// Q: Can std::atomic live in shared memory?
+// A: When it is lock-free (checked below) it is just the integer, so yes. A lock-based
+//    atomic would use a process-local lock.
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <span>
+#include <optional>
+#include <algorithm>
+#include <system_error>
+#include <stdexcept>
+#include <fstream>
+#include <thread>
+#include <type_traits>
+#include <bit>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+enum class ShmRole { Producer, Consumer };
+
+enum class ShmStatus { Ok, Timeout, Closed, PeerDead, TooLarge };
+
+const char* statusName(ShmStatus status) {
+    switch (status) {
+        case ShmStatus::Ok: return "Ok";
+        case ShmStatus::Timeout: return "Timeout";
+        case ShmStatus::Closed: return "Closed";
+        case ShmStatus::PeerDead: return "PeerDead";
+        case ShmStatus::TooLarge: return "TooLarge";
+    }
+    return "?";
+}
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free);
+
+// Process-shared futex on a 32-bit word of the segment
+inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout) {
+    timespec ts{time_t(timeout.count() / 1000000000), long(timeout.count() % 1000000000)};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline void futexWake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// false for exited and zombie processes
+inline bool processAlive(pid_t pid) {
+    if (kill(pid, 0) == -1 && errno == ESRCH) return false;
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!std::getline(stat, line)) return true;         // no /proc: trust kill()
+    size_t paren = line.rfind(')');
+    return paren == std::string::npos || paren + 2 >= line.size() ||
+           (line[paren + 2] != 'Z' && line[paren + 2] != 'X');
+}
+
+class SharedMemoryQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr auto kForever = std::chrono::milliseconds::max();
+
+    // Creates the segment (capacity rounded up to a power of two) or attaches to an
+    // existing one. Throws if another live process already has this role.
+    SharedMemoryQueue(const std::string& name, ShmRole role, size_t capacity = size_t{1} << 20)
+        : role_(role) {
+        mapSegment(name, std::bit_ceil(std::max<size_t>(capacity, 4096)));
+        attach();
+    }
+
+    // Detaches (a clean exit, not a crash); the segment lives until unlink()
+    ~SharedMemoryQueue() {
+        if (!header_) return;
+        pidSlot(role_).store(0, std::memory_order_release);
+        munmap(header_, mapped_bytes_);
+    }
+
+    SharedMemoryQueue(const SharedMemoryQueue&) = delete;
+    SharedMemoryQueue& operator=(const SharedMemoryQueue&) = delete;
+
+    static void unlink(const std::string& name) { shm_unlink(name.c_str()); }
+
+    size_t capacity() const { return capacity_; }
+
+    // Largest payload: a record plus a worst-case wrap marker must fit in the ring
+    size_t max_payload() const { return capacity_ / 2 - sizeof(RecordHeader); }
+
+    // **************** Producer ***************
+
+    // Space for a size-byte payload, written in place, then published by commit(size)
+    ShmStatus reserve(size_t size, std::span<std::byte>& out, std::chrono::milliseconds timeout = kForever) {
+        if (size > max_payload()) return ShmStatus::TooLarge;
+        size_t need = recordBytes(size);
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        size_t offset = tail & mask_;
+        size_t pad = capacity_ - offset < need ? capacity_ - offset : 0;
+
+        auto has_room = [&] {
+            return capacity_ - (tail - header_->head.load(std::memory_order_acquire)) >= pad + need;
+        };
+        ShmStatus status = waitUntil(has_room, header_->space_seq, header_->producer_waiting,
+                                     header_->consumer_pid, timeout, false);
+        if (status != ShmStatus::Ok) return status;
+
+        if (pad) {
+            // Unpublished until commit(): a crash here leaves nothing half-visible
+            record(offset)->kind = kWrap;
+            record(offset)->size = uint32_t(pad);
+            tail += pad;
+        }
+        reserved_at_ = tail;
+        reserved_size_ = size;
+        out = std::span<std::byte>(payload(tail & mask_), size);
+        return ShmStatus::Ok;
+    }
+
+    void commit(size_t size) {
+        RecordHeader* rec = record(reserved_at_ & mask_);
+        rec->size = uint32_t(std::min(size, reserved_size_));
+        rec->kind = kData;
+        header_->tail.store(reserved_at_ + recordBytes(rec->size), std::memory_order_release);
+        wakeIfWaiting(header_->consumer_waiting, header_->data_seq);
+    }
+
+    ShmStatus push(const void* data, size_t size, std::chrono::milliseconds timeout = kForever) {
+        std::span<std::byte> out;
+        ShmStatus status = reserve(size, out, timeout);
+        if (status != ShmStatus::Ok) return status;
+        std::memcpy(out.data(), data, size);
+        commit(size);
+        return ShmStatus::Ok;
+    }
+
+    template <typename T>
+    ShmStatus push(const T& value, std::chrono::milliseconds timeout = kForever) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return push(&value, sizeof(T), timeout);
+    }
+
+    // Both sides see Closed once the consumer drained everything
+    void shutdown() {
+        header_->closed.store(1, std::memory_order_seq_cst);
+        header_->data_seq.fetch_add(1, std::memory_order_release);
+        header_->space_seq.fetch_add(1, std::memory_order_release);
+        futexWake(header_->data_seq);
+        futexWake(header_->space_seq);
+    }
+
+    // **************** Consumer ***************
+
+    // The oldest record, in place; valid until pop()
+    ShmStatus front(std::span<const std::byte>& out, std::chrono::milliseconds timeout = kForever) {
+        while (true) {
+            uint64_t head = header_->head.load(std::memory_order_relaxed);
+            auto has_data = [&] { return header_->tail.load(std::memory_order_acquire) != head; };
+            ShmStatus status = waitUntil(has_data, header_->data_seq, header_->consumer_waiting,
+                                         header_->producer_pid, timeout, true);
+            if (status != ShmStatus::Ok) return status;
+
+            RecordHeader* rec = record(head & mask_);
+            if (rec->kind == kWrap) {
+                release(head + rec->size);
+                continue;
+            }
+            out = std::span<const std::byte>(payload(head & mask_), rec->size);
+            return ShmStatus::Ok;
+        }
+    }
+
+    template <typename T>
+    static const T& as(std::span<const std::byte> bytes) {
+        return *std::launder(reinterpret_cast<const T*>(bytes.data()));
+    }
+
+    // Done with the record front() returned
+    void pop() {
+        uint64_t head = header_->head.load(std::memory_order_relaxed);
+        release(head + recordBytes(record(head & mask_)->size));
+    }
+
+private:
+    static constexpr uint32_t kMagic = 0x53484d51;      // "SHMQ"
+    static constexpr uint32_t kData = 1;
+    static constexpr uint32_t kWrap = 2;
+    static constexpr auto kPeerCheck = std::chrono::milliseconds(50);
+    static constexpr int kSpins = 128;
+
+    struct Header {
+        std::atomic<uint32_t> magic;
+        uint32_t header_bytes;
+        uint64_t capacity;
+        alignas(64) std::atomic<uint64_t> tail;             // producer only
+        std::atomic<uint32_t> producer_waiting;             // producer asleep on space_seq
+        alignas(64) std::atomic<uint64_t> head;             // consumer only
+        std::atomic<uint32_t> consumer_waiting;             // consumer asleep on data_seq
+        alignas(64) std::atomic<uint32_t> data_seq;         // futex words
+        alignas(64) std::atomic<uint32_t> space_seq;
+        alignas(64) std::atomic<int32_t> producer_pid;
+        std::atomic<int32_t> consumer_pid;
+        std::atomic<uint32_t> closed;
+    };
+
+    struct RecordHeader {
+        uint32_t size;
+        uint32_t kind;
+    };
+
+    static constexpr size_t kHeaderBytes = (sizeof(Header) + 63) / 64 * 64;
+
+    static size_t recordBytes(size_t payload_size) {
+        return (sizeof(RecordHeader) + payload_size + 7) / 8 * 8;
+    }
+
+    RecordHeader* record(size_t offset) { return reinterpret_cast<RecordHeader*>(data_ + offset); }
+    std::byte* payload(size_t offset) { return data_ + offset + sizeof(RecordHeader); }
+
+    std::atomic<int32_t>& pidSlot(ShmRole role) {
+        return role == ShmRole::Producer ? header_->producer_pid : header_->consumer_pid;
+    }
+
+    void mapSegment(const std::string& name, size_t capacity) {
+        bool created = true;
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd == -1 && errno == EEXIST) {
+            created = false;
+            fd = shm_open(name.c_str(), O_RDWR, 0600);
+        }
+        if (fd == -1) throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+
+        if (created) {
+            if (ftruncate(fd, off_t(kHeaderBytes + capacity)) == -1) {
+                close(fd);
+                throw std::system_error(errno, std::generic_category(), "ftruncate " + name);
+            }
+        } else {
+            capacity = 0;
+            // The creator may still be sizing it
+            for (int tries = 0; tries < 1000 && capacity == 0; tries++) {
+                struct stat st{};
+                fstat(fd, &st);
+                if (size_t(st.st_size) > kHeaderBytes) capacity = size_t(st.st_size) - kHeaderBytes;
+                else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (capacity == 0 || !std::has_single_bit(capacity)) {
+                close(fd);
+                throw std::runtime_error("SharedMemoryQueue: " + name + " is not a queue segment");
+            }
+        }
+
+        mapped_bytes_ = kHeaderBytes + capacity;
+        void* base = mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap " + name);
+
+        header_ = static_cast<Header*>(base);
+        data_ = static_cast<std::byte*>(base) + kHeaderBytes;
+        capacity_ = capacity;
+        mask_ = capacity - 1;
+
+        if (created) {
+            // ftruncate zero-filled everything: indices, pids and flags start at 0
+            header_->header_bytes = uint32_t(kHeaderBytes);
+            header_->capacity = capacity;
+            header_->magic.store(kMagic, std::memory_order_release);
+            return;
+        }
+        for (int tries = 0; header_->magic.load(std::memory_order_acquire) != kMagic; tries++) {
+            if (tries == 1000) throw std::runtime_error("SharedMemoryQueue: " + name + " never initialized");
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Takes the role's pid slot, from nobody or from a dead process
+    void attach() {
+        std::atomic<int32_t>& slot = pidSlot(role_);
+        int32_t self = int32_t(getpid());
+        int32_t current = slot.load(std::memory_order_acquire);
+        while (true) {
+            if (current != 0 && current != self && processAlive(current)) {
+                munmap(header_, mapped_bytes_);
+                header_ = nullptr;
+                throw std::runtime_error(std::string("SharedMemoryQueue: a live ") +
+                                         (role_ == ShmRole::Producer ? "producer" : "consumer") +
+                                         " is attached (pid " + std::to_string(current) + ")");
+            }
+            if (slot.compare_exchange_weak(current, self, std::memory_order_acq_rel)) return;
+        }
+    }
+
+    void release(uint64_t head) {
+        header_->head.store(head, std::memory_order_release);
+        wakeIfWaiting(header_->producer_waiting, header_->space_seq);
+    }
+
+    // Pairs with the seq_cst flag store + re-check in waitUntil(): either the sleeper sees
+    // our index, or we see its flag. exchange: one wake per sleep, not one per record.
+    void wakeIfWaiting(std::atomic<uint32_t>& waiting, std::atomic<uint32_t>& seq) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed) && waiting.exchange(0, std::memory_order_acq_rel)) {
+            seq.fetch_add(1, std::memory_order_release);
+            futexWake(seq);
+        }
+    }
+
+    // Spins briefly, then sleeps on seq in kPeerCheck slices until ready(), the deadline,
+    // shutdown (consumer: only once drained) or the peer's death
+    template <typename Ready>
+    ShmStatus waitUntil(Ready&& ready, std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting,
+                        std::atomic<int32_t>& peer, std::chrono::milliseconds timeout, bool drain_first) {
+        for (int spins = 0; spins < kSpins; spins++) {
+            if (ready()) return ShmStatus::Ok;
+        }
+        auto deadline = timeout == kForever ? Clock::time_point::max() : Clock::now() + timeout;
+        while (true) {
+            if (ready()) return ShmStatus::Ok;
+            if (header_->closed.load(std::memory_order_acquire))
+                return drain_first && ready() ? ShmStatus::Ok : ShmStatus::Closed;
+
+            uint32_t seen = seq.load(std::memory_order_acquire);
+            waiting.store(1, std::memory_order_seq_cst);
+            if (!ready() && !header_->closed.load(std::memory_order_seq_cst)) {
+                auto now = Clock::now();
+                if (now >= deadline) {
+                    waiting.store(0, std::memory_order_relaxed);
+                    return ShmStatus::Timeout;
+                }
+                futexWait(seq, seen, std::min<Clock::duration>(kPeerCheck, deadline - now));
+            }
+            waiting.store(0, std::memory_order_relaxed);
+
+            if (ready()) return ShmStatus::Ok;
+            int32_t pid = peer.load(std::memory_order_acquire);
+            if (pid != 0 && !processAlive(pid)) return ShmStatus::PeerDead;
+        }
+    }
+
+    ShmRole role_;
+    Header* header_ = nullptr;
+    std::byte* data_ = nullptr;
+    size_t mapped_bytes_ = 0;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    uint64_t reserved_at_ = 0;                      // producer: position of the reserved record
+    size_t reserved_size_ = 0;
+};
+
+// **************** Benchmark ***************
+
+// The producer is this process, the consumer a fork()ed child; both transports carry the
+// same messages: an 8-byte steady_clock stamp (CLOCK_MONOTONIC, same clock in both
+// processes) + filler, and the consumer sums every 8-byte word of the payload (reads all of
+// it, zero-copy or not). Results come back through a MAP_SHARED anonymous page.
+//  - shm: SharedMemoryQueue, payload written in place with reserve/commit, read in place
+//  - unix socket: SOCK_STREAM socketpair, one write() per message (length + payload), the
+//    consumer read()s 64 KB at a time and parses messages out of its buffer
+// "flat out": throughput; "paced": one message every kPaceNs, latency of a single hand-off.
+
+struct Histogram {
+    static constexpr int kBuckets = 40;
+    uint64_t counts[kBuckets] = {};
+    uint64_t max_ns = 0;
+    uint64_t total = 0;
+
+    void add(uint64_t ns) {
+        counts[std::min(kBuckets - 1, int(std::bit_width(ns)))]++;
+        max_ns = std::max(max_ns, ns);
+        total++;
+    }
+
+    uint64_t percentile(double q) const {
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += counts[i];
+            if (seen >= q * total) return std::min(max_ns, i == 0 ? 0 : (uint64_t{1} << i) - 1);
+        }
+        return max_ns;
+    }
+};
+
+struct ConsumerResult {
+    Histogram latency;
+    uint64_t checksum;
+    double seconds;                 // first to last message
+};
+
+inline uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t sumWords(const std::byte* data, size_t size) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        sum += word;
+    }
+    return sum;
+}
+
+inline void fillMessage(std::byte* out, size_t size, uint64_t seq) {
+    uint64_t stamp = nowNs();
+    std::memcpy(out, &stamp, 8);
+    for (size_t i = 8; i + 8 <= size; i += 8) std::memcpy(out + i, &seq, 8);
+}
+
+inline void paceUntil(uint64_t& next, uint64_t pace_ns) {
+    if (!pace_ns) return;
+    next += pace_ns;
+    while (nowNs() < next) {}
+}
+
+template <typename Consume>
+ConsumerResult* forkConsumer(pid_t& child, Consume&& consume) {
+    void* page = mmap(nullptr, sizeof(ConsumerResult), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    auto* result = new (page) ConsumerResult{};
+    child = fork();
+    if (child == 0) {
+        consume(*result);
+        _exit(0);
+    }
+    return result;
+}
+
+ConsumerResult runShm(size_t msg_bytes, uint64_t count, uint64_t pace_ns) {
+    std::string name = "/bbq_bench_" + std::to_string(getpid());
+    SharedMemoryQueue::unlink(name);
+    SharedMemoryQueue producer(name, ShmRole::Producer, size_t{1} << 22);
+
+    pid_t child;
+    ConsumerResult* result = forkConsumer(child, [&](ConsumerResult& out) {
+        SharedMemoryQueue consumer(name, ShmRole::Consumer);
+        std::span<const std::byte> msg;
+        uint64_t first = 0;
+        for (uint64_t i = 0; i < count && consumer.front(msg) == ShmStatus::Ok; i++) {
+            uint64_t now = nowNs();
+            if (i == 0) first = now;
+            out.latency.add(now - SharedMemoryQueue::as<uint64_t>(msg));
+            out.checksum += sumWords(msg.data(), msg.size());
+            consumer.pop();
+        }
+        out.seconds = (nowNs() - first) / 1e9;
+    });
+
+    uint64_t next = nowNs();
+    for (uint64_t i = 0; i < count; i++) {
+        paceUntil(next, pace_ns);
+        std::span<std::byte> out;
+        if (producer.reserve(msg_bytes, out) != ShmStatus::Ok) break;
+        fillMessage(out.data(), msg_bytes, i);
+        producer.commit(msg_bytes);
+    }
+    waitpid(child, nullptr, 0);
+    SharedMemoryQueue::unlink(name);
+    ConsumerResult copy = *result;
+    munmap(result, sizeof(ConsumerResult));
+    return copy;
+}
+
+ConsumerResult runSocket(size_t msg_bytes, uint64_t count, uint64_t pace_ns) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) throw std::system_error(errno, std::generic_category(), "socketpair");
+
+    pid_t child;
+    ConsumerResult* result = forkConsumer(child, [&](ConsumerResult& out) {
+        close(fds[0]);
+        std::vector<std::byte> buffer(1 << 16);
+        size_t filled = 0, parsed = 0;
+        uint64_t first = 0;
+        for (uint64_t received = 0; received < count;) {
+            if (filled - parsed < 4 + msg_bytes) {
+                std::memmove(buffer.data(), buffer.data() + parsed, filled - parsed);
+                filled -= parsed;
+                parsed = 0;
+                ssize_t n = read(fds[1], buffer.data() + filled, buffer.size() - filled);
+                if (n <= 0) break;
+                filled += size_t(n);
+                continue;
+            }
+            uint32_t size;
+            std::memcpy(&size, buffer.data() + parsed, 4);
+            const std::byte* msg = buffer.data() + parsed + 4;
+            uint64_t now = nowNs(), stamp;
+            if (received == 0) first = now;
+            std::memcpy(&stamp, msg, 8);
+            out.latency.add(now - stamp);
+            out.checksum += sumWords(msg, size);
+            parsed += 4 + size;
+            received++;
+        }
+        out.seconds = (nowNs() - first) / 1e9;
+    });
+
+    close(fds[1]);
+    std::vector<std::byte> message(4 + msg_bytes);
+    uint32_t size = uint32_t(msg_bytes);
+    std::memcpy(message.data(), &size, 4);
+    uint64_t next = nowNs();
+    for (uint64_t i = 0; i < count; i++) {
+        paceUntil(next, pace_ns);
+        fillMessage(message.data() + 4, msg_bytes, i);
+        for (size_t sent = 0; sent < message.size();) {
+            ssize_t n = write(fds[0], message.data() + sent, message.size() - sent);
+            if (n <= 0) break;
+            sent += size_t(n);
+        }
+    }
+    close(fds[0]);
+    waitpid(child, nullptr, 0);
+    ConsumerResult copy = *result;
+    munmap(result, sizeof(ConsumerResult));
+    return copy;
+}
+
+void benchTransports() {
+    constexpr uint64_t kPaceNs = 20000;
+
+    std::cout << "transport      msg bytes   load       M msgs/s     p50      p99    p99.9      max (us)\n";
+    for (bool paced : {false, true}) {
+        for (size_t bytes : {64, 4096}) {
+            uint64_t count = paced ? 20000 : (bytes <= 64 ? 2000000 : 200000);
+            struct {
+                const char* name;
+                ConsumerResult result;
+            } rows[] = {
+                {"shm queue", runShm(bytes, count, paced ? kPaceNs : 0)},
+                {"unix socket", runSocket(bytes, count, paced ? kPaceNs : 0)},
+            };
+            for (auto& [name, r] : rows) {
+                std::cout << std::left << std::setw(15) << name << std::right << std::setw(9) << bytes
+                          << std::setw(11) << (paced ? "paced" : "flat out") << std::fixed << std::setprecision(3)
+                          << std::setw(13) << (r.seconds > 0 ? r.latency.total / r.seconds / 1e6 : 0)
+                          << (r.latency.total == count ? " " : "!") << std::setprecision(1);
+                for (double q : {0.5, 0.99, 0.999}) std::cout << std::setw(9) << r.latency.percentile(q) / 1e3;
+                std::cout << std::setw(9) << r.latency.max_ns / 1e3 << '\n';
+            }
+        }
+    }
+}
+
+// **************** Crash recovery ***************
+
+struct CrashRecord {
+    uint64_t seq;
+    char filler[504];
+};
+
+void crashTest() {
+    std::string name = "/bbq_crash_" + std::to_string(getpid());
+    constexpr uint64_t kRecords = 100;
+
+    // 1. Consumer dies holding record 10 (front() without pop()), producer is blocked on a
+    //    full ring. The replacement consumer must start at record 10.
+    {
+        SharedMemoryQueue::unlink(name);
+        SharedMemoryQueue producer(name, ShmRole::Producer, 4096);        // 7 records fit
+        pid_t first = fork();
+        if (first == 0) {
+            SharedMemoryQueue consumer(name, ShmRole::Consumer);
+            std::span<const std::byte> msg;
+            for (int i = 0; i < 10 && consumer.front(msg) == ShmStatus::Ok; i++) consumer.pop();
+            consumer.front(msg);
+            raise(SIGKILL);
+        }
+
+        uint64_t seq = 0;
+        ShmStatus status = ShmStatus::Ok;
+        for (; seq < kRecords; seq++) {
+            status = producer.push(CrashRecord{seq, {}});
+            if (status != ShmStatus::Ok) break;
+        }
+        std::cout << "consumer killed: producer push #" << seq << " -> " << statusName(status) << '\n';
+        waitpid(first, nullptr, 0);
+
+        pid_t second = fork();
+        if (second == 0) {
+            SharedMemoryQueue consumer(name, ShmRole::Consumer);
+            std::span<const std::byte> msg;
+            uint64_t expected = 10, bad = 0;
+            while (consumer.front(msg) == ShmStatus::Ok) {
+                bad += SharedMemoryQueue::as<CrashRecord>(msg).seq != expected++;
+                consumer.pop();
+            }
+            _exit(bad == 0 && expected == kRecords ? 0 : 1);
+        }
+        for (; seq < kRecords; seq++) producer.push(CrashRecord{seq, {}});
+        producer.shutdown();
+        int exit_status = 0;
+        waitpid(second, &exit_status, 0);
+        std::cout << "replacement consumer got records 10.." << kRecords - 1 << " in order: "
+                  << (WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0 ? "yes" : "NO") << '\n';
+    }
+
+    // 2. Producer dies halfway through writing record 5. The consumer must see 0..4, then
+    //    PeerDead, and a replacement producer carries on with 5..9.
+    {
+        SharedMemoryQueue::unlink(name);
+        SharedMemoryQueue consumer(name, ShmRole::Consumer, 4096);
+        pid_t first = fork();
+        if (first == 0) {
+            SharedMemoryQueue producer(name, ShmRole::Producer);
+            for (uint64_t seq = 0; seq < 5; seq++) producer.push(CrashRecord{seq, {}});
+            std::span<std::byte> out;
+            producer.reserve(sizeof(CrashRecord), out);
+            std::memset(out.data(), 0xff, out.size() / 2);
+            raise(SIGKILL);
+        }
+
+        std::span<const std::byte> msg;
+        std::vector<uint64_t> seen;
+        ShmStatus status;
+        while ((status = consumer.front(msg)) == ShmStatus::Ok) {
+            seen.push_back(SharedMemoryQueue::as<CrashRecord>(msg).seq);
+            consumer.pop();
+        }
+        waitpid(first, nullptr, 0);
+        std::cout << "producer killed mid-record: consumer got " << seen.size() << " records, then "
+                  << statusName(status) << '\n';
+
+        pid_t second = fork();
+        if (second == 0) {
+            SharedMemoryQueue producer(name, ShmRole::Producer);
+            for (uint64_t seq = 5; seq < 10; seq++) producer.push(CrashRecord{seq, {}});
+            producer.shutdown();
+            _exit(0);
+        }
+        while ((status = consumer.front(msg)) == ShmStatus::Ok) {
+            seen.push_back(SharedMemoryQueue::as<CrashRecord>(msg).seq);
+            consumer.pop();
+        }
+        waitpid(second, nullptr, 0);
+        bool in_order = seen.size() == 10;
+        for (size_t i = 0; i < seen.size(); i++) in_order = in_order && seen[i] == i;
+        std::cout << "replacement producer: records 0..9 in order, no partial record: "
+                  << (in_order ? "yes" : "NO") << ", then " << statusName(status) << '\n';
+    }
+    SharedMemoryQueue::unlink(name);
+}
+
+// **************** Separate processes ***************
+
+void produce(const std::string& name, uint64_t count, size_t bytes) {
+    SharedMemoryQueue queue(name, ShmRole::Producer);
+    std::vector<std::byte> message(std::max<size_t>(bytes, 8));
+    for (uint64_t i = 0; i < count; i++) {
+        fillMessage(message.data(), message.size(), i);
+        ShmStatus status = queue.push(message.data(), message.size());
+        if (status != ShmStatus::Ok) {
+            std::cout << "push #" << i << ": " << statusName(status) << '\n';
+            return;
+        }
+    }
+    queue.shutdown();
+}
+
+void consume(const std::string& name) {
+    SharedMemoryQueue queue(name, ShmRole::Consumer);
+    std::span<const std::byte> msg;
+    Histogram latency;
+    uint64_t first = 0;
+    ShmStatus status;
+    while ((status = queue.front(msg)) == ShmStatus::Ok) {
+        uint64_t now = nowNs();
+        if (!first) first = now;
+        latency.add(now - SharedMemoryQueue::as<uint64_t>(msg));
+        queue.pop();
+    }
+    double seconds = first ? (nowNs() - first) / 1e9 : 0;
+    std::cout << latency.total << " messages, " << std::fixed << std::setprecision(3)
+              << (seconds > 0 ? latency.total / seconds / 1e6 : 0) << " M msgs/s, p50 "
+              << latency.percentile(0.5) / 1e3 << " us, p99 " << latency.percentile(0.99) / 1e3 << " us, then "
+              << statusName(status) << '\n';
+    SharedMemoryQueue::unlink(name);
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "crash") {
+        crashTest();
+        return 0;
+    }
+    if (mode == "produce" && argc > 2) {
+        produce(argv[2], argc > 3 ? std::stoull(argv[3]) : 1000000, argc > 4 ? std::stoul(argv[4]) : 64);
+        return 0;
+    }
+    if (mode == "consume" && argc > 2) {
+        consume(argv[2]);
+        return 0;
+    }
+    benchTransports();
+    return 0;
+}
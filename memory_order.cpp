@@ -0,0 +1,356 @@
+// g++ -std=c++20 -O2 -pthread memory_order.cpp
+//   ./a.out [max threads] [csv]  → atomics / memory order / false sharing table, 1..max threads
+//                                  (max threads defaults to hardware_concurrency)
+
+// **************** Memory order & false sharing microbenchmarks ***************
+
+// What the orderings cost here, measured instead of argued. Every cell is ns per operation
+// as seen by one thread (wall time / iterations per thread), for 1, 2, 4 ... threads:
+//  - fetch_add / CAS loop on one shared counter, relaxed vs acq_rel vs seq_cst
+//  - store / load of a thread-private atomic, relaxed vs release/acquire vs seq_cst
+//  - per-thread counters packed in one array vs alignas(64), with fetch_add and with the
+//    single-writer store(load + 1) the pool metrics use
+//  - BWMutex, SpinLock (BusyWaitingMutex.cpp) and std::mutex around a shared increment
+//  - the pool's stop_ flag: workers poll it while a submitter bumps queued_, which sits
+//    right next to stop_ in ThreadPool (same cache line) vs a padded layout
+// Then a 2-thread message-passing ping-pong: data + flag, round-trip ns under each ordering,
+// and how often the receiver saw the flag but stale data (only possible with relaxed, and
+// only on weakly ordered CPUs: 0 on x86 is expected, not proof).
+// "csv" prints the same numbers as CSV for diffing machines.
+
+// Q: Why do relaxed and seq_cst fetch_add cost the same on x86?
+// A: Every locked read-modify-write is a full barrier there. The orderings differ for plain
+//    stores (seq_cst store = xchg, release store = mov) and on ARM/POWER, where acquire /
+//    release / seq_cst map to different instructions (ldar/stlr, dmb).
+
+// Q: Why does a packed counter array slow down even though no counter is shared?
+// A: The cache line is. 8 counters per 64-byte line: each increment steals the line from
+//    the other cores (false sharing). alignas(64) gives every counter its own line.
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "BusyWaitingMutex.cpp"             // BWMutex, SpinLock (no main)
+
+constexpr size_t kCacheLine = 64;
+constexpr size_t kMaxThreads = 256;
+
+struct alignas(kCacheLine) PaddedCounter {
+    std::atomic<uint64_t> value{0};
+};
+
+// Runs body(thread index) on `threads` threads started together, returns wall ns
+template <typename Body>
+double runThreads(int threads, Body&& body) {
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            body(t);
+        });
+    }
+    while (ready.load() < threads) std::this_thread::yield();
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers) w.join();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Keeps a loaded value alive without a memory access
+template <typename T>
+void keep(T value) {
+    asm volatile("" : : "r"(value));
+}
+
+constexpr const char* orderName(std::memory_order order) {
+    switch (order) {
+        case std::memory_order_relaxed: return "relaxed";
+        case std::memory_order_acquire: return "acquire";
+        case std::memory_order_release: return "release";
+        case std::memory_order_acq_rel: return "acq_rel";
+        case std::memory_order_seq_cst: return "seq_cst";
+        default: return "?";
+    }
+}
+
+// **************** Shared counter ***************
+
+template <std::memory_order Order>
+double fetchAddShared(int threads, long iters) {
+    std::atomic<uint64_t> counter{0};
+    return runThreads(threads, [&](int) {
+        for (long i = 0; i < iters; i++) counter.fetch_add(1, Order);
+    }) / iters;
+}
+
+template <std::memory_order Order>
+double casLoopShared(int threads, long iters) {
+    std::atomic<uint64_t> counter{0};
+    return runThreads(threads, [&](int) {
+        for (long i = 0; i < iters; i++) {
+            uint64_t old = counter.load(std::memory_order_relaxed);
+            while (!counter.compare_exchange_weak(old, old + 1, Order, std::memory_order_relaxed)) {}
+        }
+    }) / iters;
+}
+
+// **************** Private store / load ***************
+
+template <std::memory_order Order>
+double storePrivate(int threads, long iters) {
+    std::vector<PaddedCounter> slots(threads);
+    return runThreads(threads, [&](int t) {
+        for (long i = 0; i < iters; i++) slots[t].value.store(uint64_t(i), Order);
+    }) / iters;
+}
+
+template <std::memory_order Order>
+double loadPrivate(int threads, long iters) {
+    std::vector<PaddedCounter> slots(threads);
+    return runThreads(threads, [&](int t) {
+        uint64_t sum = 0;
+        for (long i = 0; i < iters; i++) sum += slots[t].value.load(Order);
+        keep(sum);
+    }) / iters;
+}
+
+// **************** Packed vs padded counters ***************
+
+// Each thread only touches counters[t]
+template <bool Padded, bool SingleWriter>
+double perThreadCounters(int threads, long iters) {
+    std::vector<PaddedCounter> padded(threads);
+    std::vector<std::atomic<uint64_t>> packed(threads);
+    return runThreads(threads, [&](int t) {
+        std::atomic<uint64_t>& counter = Padded ? padded[t].value : packed[t];
+        for (long i = 0; i < iters; i++) {
+            if constexpr (SingleWriter)
+                counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            else
+                counter.fetch_add(1, std::memory_order_relaxed);
+        }
+    }) / iters;
+}
+
+// **************** Locks ***************
+
+// < 0: the lock let two threads in (lost increments)
+template <typename Lock>
+double lockedIncrement(int threads, long iters) {
+    Lock lock;
+    uint64_t counter = 0;
+    double ns = runThreads(threads, [&](int) {
+        for (long i = 0; i < iters; i++) {
+            lock.lock();
+            counter++;
+            lock.unlock();
+        }
+    }) / iters;
+    return counter == uint64_t(threads) * iters ? ns : -ns;
+}
+
+// **************** Pool stop flag ***************
+
+// ThreadPool keeps queued_, idle_workers_ and stop_ next to each other
+struct PackedPoolFlags {
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> idle_workers{0};
+    std::atomic<bool> stop{false};
+};
+
+struct PaddedPoolFlags {
+    alignas(kCacheLine) std::atomic<size_t> queued{0};
+    std::atomic<size_t> idle_workers{0};
+    alignas(kCacheLine) std::atomic<bool> stop{false};
+};
+
+// Workers poll stop the way the worker loop does (default seq_cst load) while one extra
+// submitter thread keeps bumping queued; ns per poll
+template <typename Flags, std::memory_order Order>
+double pollStopFlag(int threads, long iters) {
+    Flags flags;
+    std::atomic<bool> done{false};
+    std::thread submitter([&] {
+        while (!done.load(std::memory_order_relaxed)) flags.queued.fetch_add(1, std::memory_order_relaxed);
+    });
+    double ns = runThreads(threads, [&](int) {
+        uint64_t polls = 0;
+        for (long i = 0; i < iters; i++) polls += !flags.stop.load(Order);
+        keep(polls);
+    }) / iters;
+    done = true;
+    submitter.join();
+    return ns;
+}
+
+// **************** Message passing ***************
+
+struct PingPongResult {
+    double round_trip_ns;
+    uint64_t stale;                     // flag seen, data not yet
+};
+
+// A writes data then flag, B waits for the flag and checks data, then answers the same way
+template <std::memory_order Store, std::memory_order Load>
+PingPongResult pingPong(long rounds) {
+    struct alignas(kCacheLine) Mailbox {
+        std::atomic<uint64_t> data{0};
+        std::atomic<uint64_t> flag{0};
+    };
+    Mailbox ping, pong;
+    std::atomic<uint64_t> stale{0};
+
+    auto await = [](Mailbox& box, uint64_t round) {
+        for (int spins = 0; box.flag.load(Load) != round; spins++) {
+            if (spins > 64) std::this_thread::yield();      // still makes progress on one core
+        }
+    };
+    double ns = runThreads(2, [&](int t) {
+        uint64_t local_stale = 0;
+        for (uint64_t round = 1; round <= uint64_t(rounds); round++) {
+            if (t == 0) {
+                ping.data.store(round, std::memory_order_relaxed);
+                ping.flag.store(round, Store);
+                await(pong, round);
+                local_stale += pong.data.load(std::memory_order_relaxed) != round;
+            } else {
+                await(ping, round);
+                local_stale += ping.data.load(std::memory_order_relaxed) != round;
+                pong.data.store(round, std::memory_order_relaxed);
+                pong.flag.store(round, Store);
+            }
+        }
+        stale += local_stale;
+    });
+    return {ns / rounds, stale.load()};
+}
+
+// **************** Table ***************
+
+struct Row {
+    std::string group;
+    std::string variant;
+    std::function<double(int threads)> run;
+};
+
+std::vector<Row> rows(long iters) {
+    using std::memory_order_relaxed, std::memory_order_acquire, std::memory_order_release,
+          std::memory_order_acq_rel, std::memory_order_seq_cst;
+    auto bind = [iters](double (*f)(int, long)) { return [f, iters](int threads) { return f(threads, iters); }; };
+    return {
+        {"fetch_add shared", orderName(memory_order_relaxed), bind(fetchAddShared<memory_order_relaxed>)},
+        {"fetch_add shared", orderName(memory_order_acq_rel), bind(fetchAddShared<memory_order_acq_rel>)},
+        {"fetch_add shared", orderName(memory_order_seq_cst), bind(fetchAddShared<memory_order_seq_cst>)},
+        {"CAS loop shared", orderName(memory_order_relaxed), bind(casLoopShared<memory_order_relaxed>)},
+        {"CAS loop shared", orderName(memory_order_acq_rel), bind(casLoopShared<memory_order_acq_rel>)},
+        {"CAS loop shared", orderName(memory_order_seq_cst), bind(casLoopShared<memory_order_seq_cst>)},
+        {"store private", orderName(memory_order_relaxed), bind(storePrivate<memory_order_relaxed>)},
+        {"store private", orderName(memory_order_release), bind(storePrivate<memory_order_release>)},
+        {"store private", orderName(memory_order_seq_cst), bind(storePrivate<memory_order_seq_cst>)},
+        {"load private", orderName(memory_order_relaxed), bind(loadPrivate<memory_order_relaxed>)},
+        {"load private", orderName(memory_order_acquire), bind(loadPrivate<memory_order_acquire>)},
+        {"load private", orderName(memory_order_seq_cst), bind(loadPrivate<memory_order_seq_cst>)},
+        {"own counter fetch_add", "packed", bind(perThreadCounters<false, false>)},
+        {"own counter fetch_add", "alignas(64)", bind(perThreadCounters<true, false>)},
+        {"own counter store(load+1)", "packed", bind(perThreadCounters<false, true>)},
+        {"own counter store(load+1)", "alignas(64)", bind(perThreadCounters<true, true>)},
+        {"lock + ++counter", "BWMutex", bind(lockedIncrement<BWMutex>)},
+        {"lock + ++counter", "SpinLock", bind(lockedIncrement<SpinLock>)},
+        {"lock + ++counter", "std::mutex", bind(lockedIncrement<std::mutex>)},
+        {"poll stop_ (queued_ busy)", "packed seq_cst", bind(pollStopFlag<PackedPoolFlags, memory_order_seq_cst>)},
+        {"poll stop_ (queued_ busy)", "packed relaxed", bind(pollStopFlag<PackedPoolFlags, memory_order_relaxed>)},
+        {"poll stop_ (queued_ busy)", "padded seq_cst", bind(pollStopFlag<PaddedPoolFlags, memory_order_seq_cst>)},
+    };
+}
+
+void printTable(int max_threads, bool csv) {
+    constexpr long kIters = 2000000;
+    constexpr long kRounds = 200000;
+
+    std::vector<int> counts;
+    for (int threads = 1; threads <= max_threads; threads *= 2) counts.push_back(threads);
+
+#if defined(__x86_64__)
+    const char* arch = "x86-64";
+#elif defined(__aarch64__)
+    const char* arch = "aarch64";
+#else
+    const char* arch = "other";
+#endif
+    if (csv) {
+        std::cout << "arch,cores,benchmark,variant,threads,ns_per_op\n";
+    } else {
+        std::cout << arch << ", " << std::thread::hardware_concurrency() << " hardware threads. ns per op per thread"
+                  << " (! = lock lost increments)\n";
+        std::cout << std::left << std::setw(28) << "benchmark" << std::setw(16) << "variant" << std::right;
+        for (int threads : counts) std::cout << std::setw(8) << threads << 't';
+        std::cout << '\n';
+    }
+
+    for (const Row& row : rows(kIters)) {
+        if (!csv) std::cout << std::left << std::setw(28) << row.group << std::setw(16) << row.variant << std::right;
+        for (int threads : counts) {
+            double ns = row.run(threads);
+            bool broken = ns < 0;
+            if (csv) {
+                std::cout << arch << ',' << std::thread::hardware_concurrency() << ',' << row.group << ','
+                          << row.variant << ',' << threads << ',' << (broken ? -ns : ns) << (broken ? "!" : "") << '\n';
+            } else {
+                std::cout << std::fixed << std::setprecision(2) << std::setw(8) << (broken ? -ns : ns)
+                          << (broken ? '!' : ' ');
+            }
+        }
+        if (!csv) std::cout << '\n';
+    }
+
+    using std::memory_order_relaxed, std::memory_order_acquire, std::memory_order_release, std::memory_order_seq_cst;
+    struct {
+        const char* variant;
+        PingPongResult result;
+    } ping_pongs[] = {
+        {"release/acquire", pingPong<memory_order_release, memory_order_acquire>(kRounds)},
+        {"seq_cst", pingPong<memory_order_seq_cst, memory_order_seq_cst>(kRounds)},
+        {"relaxed", pingPong<memory_order_relaxed, memory_order_relaxed>(kRounds)},
+    };
+    if (!csv) std::cout << "\nmessage passing, 2 threads   round trip ns   stale data seen\n";
+    for (auto& [variant, result] : ping_pongs) {
+        if (csv) {
+            std::cout << arch << ',' << std::thread::hardware_concurrency() << ",message passing round trip,"
+                      << variant << ",2," << result.round_trip_ns << '\n';
+            std::cout << arch << ',' << std::thread::hardware_concurrency() << ",message passing stale reads,"
+                      << variant << ",2," << result.stale << '\n';
+        } else {
+            std::cout << "  " << std::left << std::setw(28) << variant << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(12) << result.round_trip_ns << std::setw(18)
+                      << result.stale << '\n';
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int max_threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    bool csv = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "csv")
+            csv = true;
+        else
+            max_threads = std::stoi(arg);
+    }
+    if (max_threads > int(kMaxThreads)) max_threads = int(kMaxThreads);
+    printTable(max_threads, csv);
+    return 0;
+}
@@ -76,8 +76,30 @@
 
 // How would you detect and handle deadlocks or livelocks in this scenario?
 
+// g++ -std=c++20 -O2 -pthread producer_consumer.cpp
+//   ./a.out        → the mutex + condition variable pipeline below (logs every item)
+//   ./a.out spsc   → same pipeline over SpscRing, blocking pop that parks when empty
+//   ./a.out bench  → items/s: mutex pipeline vs SpscRing (per item, blocking, push_n/pop_n)
+//   ./a.out multicast → 1 producer, 3 consumers: MulticastRing vs three BoundedBlockingQueues
+
 #include <iostream>
 #include <thread>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+
+#include "BoundedBlockingQueue.cpp"        // the queue the multicast ring is benchmarked against (no main)
 
 std::queue<int> tasks;
 std::mutex m;
@@ -147,7 +169,649 @@ void producer(){
 
 }
 
-int main() {
+// **************** Wait-free SPSC ring ***************
+
+// One producer, one consumer: no lock and no CAS needed. The producer is the only writer of
+// tail_, the consumer the only writer of head_; each publishes with a release store and
+// reads the other's index with acquire. try_push / try_pop / push_n / pop_n finish in a
+// bounded number of steps (wait-free).
+//  - cached indices: the producer keeps its last view of head_ and only re-reads head_
+//    (the consumer's cache line) when that view says full; same for the consumer and tail_
+//  - push_n / pop_n move a whole batch for one index load and one index store
+//  - head_ and tail_ live on separate cache lines, next to the owner's cached copy
+// pop() is the optional blocking wait: with SpscWait::Park it spins a little, then parks on
+// a futex (std::atomic::wait) only after re-checking that the ring is really empty. The
+// producer then pays a fence + flag load per push / push_n batch to see if it has to wake
+// the consumer. SpscWait::Spin never parks (pop() spins / yields), pushes stay fence-free.
+// A full ring makes push() yield: the producer is the fast side in our pipelines.
+
+// Q: Why round the capacity up to a power of two?
+// A: index & mask instead of index % capacity. The indices run freely (never wrapped), so
+//    tail_ - head_ is always the number of items, with no "one slot empty" trick.
+
+enum class SpscWait { Spin, Park };
+
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity, SpscWait wait = SpscWait::Spin)
+        : capacity_(std::bit_ceil(capacity < 2 ? size_t{2} : capacity)),
+          mask_(capacity_ - 1),
+          items_(new T[capacity_]),
+          wait_(wait) {}
+
+    // Producer side
+
+    bool try_push(T value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == capacity_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == capacity_) return false;
+        }
+        items_[tail & mask_] = std::move(value);
+        publish(tail + 1);
+        return true;
+    }
+
+    // Pushes as many of items[0, n) as fit, returns how many
+    size_t push_n(const T* items, size_t n) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (capacity_ - (tail - cached_head_) < n) cached_head_ = head_.load(std::memory_order_acquire);
+        n = std::min(n, capacity_ - (tail - cached_head_));
+        for (size_t i = 0; i < n; i++) items_[(tail + i) & mask_] = items[i];
+        if (n) publish(tail + n);
+        return n;
+    }
+
+    void push(T value) {
+        while (!try_push(value)) std::this_thread::yield();
+    }
+
+    // No push after close(); pop() returns false once the ring is drained
+    void close() {
+        closed_.store(true, std::memory_order_seq_cst);
+        wake_.fetch_add(1, std::memory_order_release);
+        wake_.notify_one();
+    }
+
+    // Consumer side
+
+    bool try_pop(T& out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) return false;
+        }
+        out = std::move(items_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Pops up to max items into out, returns how many
+    size_t pop_n(T* out, size_t max) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (cached_tail_ - head < max) cached_tail_ = tail_.load(std::memory_order_acquire);
+        size_t n = std::min(max, cached_tail_ - head);
+        for (size_t i = 0; i < n; i++) out[i] = std::move(items_[(head + i) & mask_]);
+        if (n) head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // Waits for an item; false once closed and drained
+    bool pop(T& out) {
+        while (true) {
+            for (int spins = 0; spins < kSpins; spins++) {
+                if (try_pop(out)) return true;
+            }
+            if (closed_.load(std::memory_order_acquire))
+                return try_pop(out);            // everything pushed before close() is visible
+            if (wait_ == SpscWait::Spin) {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t seen = wake_.load(std::memory_order_acquire);
+            parked_.store(true, std::memory_order_seq_cst);
+            // Truly empty? The producer's fence pairs with the seq_cst store above: either it
+            // sees parked_, or we see its tail_
+            if (tail_.load(std::memory_order_seq_cst) == head_.load(std::memory_order_relaxed) &&
+                !closed_.load(std::memory_order_seq_cst)) {
+                wake_.wait(seen, std::memory_order_acquire);
+            }
+            parked_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    static constexpr int kSpins = 64;
+    static constexpr size_t kCacheLine = 64;
+
+    void publish(size_t tail) {
+        tail_.store(tail, std::memory_order_release);
+        if (wait_ == SpscWait::Park) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // exchange: one wake-up per park, not one per push until the consumer runs
+            if (parked_.load(std::memory_order_relaxed) && parked_.exchange(false, std::memory_order_acq_rel)) {
+                wake_.fetch_add(1, std::memory_order_release);
+                wake_.notify_one();
+            }
+        }
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> items_;
+    const SpscWait wait_;
+
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};      // written by the producer only
+    size_t cached_head_ = 0;                                // producer's last view of head_
+    alignas(kCacheLine) std::atomic<size_t> head_{0};      // written by the consumer only
+    size_t cached_tail_ = 0;                                // consumer's last view of tail_
+    alignas(kCacheLine) std::atomic<bool> parked_{false};
+    std::atomic<uint32_t> wake_{0};
+    std::atomic<bool> closed_{false};
+};
+
+// The pipeline above on a ring: no lock, no notify per item
+void runSpscPipeline() {
+    SpscRing<int> ring(MAX_SIZE, SpscWait::Park);
+    std::thread cons([&] {
+        int val;
+        while (ring.pop(val)) log(" Consumed Value " + std::to_string(val));
+    });
+    for (int i = 0; i < 100; i++) {
+        ring.push(i);
+        log(" Pushed Value " + std::to_string(i));
+    }
+    ring.close();
+    cons.join();
+}
+
+// **************** Multicast ring (Disruptor) ***************
+
+// SpscRing hands every item to one consumer. MulticastRing hands every item to every
+// consumer, in order: journaling, replication and business logic each see the whole stream,
+// without the producer copying it into one queue per consumer.
+//  - the ring is pre-allocated; a slot is written once and read in place by all consumers
+//  - the producer cursor published_ and one cursor per consumer (items consumed) are the
+//    only shared state; each has a single writer, so no lock and no CAS
+//  - dependency barriers: add_consumer({a, b}) gates the new consumer on consumers a and b
+//    as well as on the producer, so it only sees an item once they are done with it
+//    (e.g. business logic runs after journaling and replication)
+//  - batching: claim(n) reserves n slots for one check of the slowest consumer, publish()
+//    makes them visible with one store; wait_for() returns everything available at once and
+//    release() acknowledges the batch with one store
+//  - the producer wraps around only once the slowest consumer has released the slot;
+//    consumers that are ahead never wait for it
+// Waiting as in SpscRing: Spin yields, Park parks on a futex after re-checking. A full ring
+// makes the producer yield. Consumers are registered before any thread starts.
+
+// Q: Why not a queue per consumer?
+// A: n queues mean n copies of each item and n enqueue/dequeue pairs on the producer's
+//    thread. The ring costs one write per item, and a consumer's reads never write to the
+//    lines the producer writes (only its own cursor).
+
+// Q: How does a consumer on a dependency know an item is ready?
+// A: Its barrier is min(published_, cursors of the consumers it depends on). Each cursor is
+//    released with a release store, so the item and everything those consumers did to it
+//    is visible once the acquire load of the cursor says so.
+
+template <typename T>
+class MulticastRing {
+public:
+    explicit MulticastRing(size_t capacity, SpscWait wait = SpscWait::Spin)
+        : capacity_(std::bit_ceil(capacity < 2 ? size_t{2} : capacity)),
+          mask_(capacity_ - 1),
+          items_(new T[capacity_]),
+          wait_(wait) {}
+
+    // Registers a consumer gated on the producer and on the given consumers, returns its id
+    size_t add_consumer(std::initializer_list<size_t> depends_on = {}) {
+        auto cursor = std::make_unique<Cursor>();
+        cursor->depends_on.assign(depends_on.begin(), depends_on.end());
+        cursors_.push_back(std::move(cursor));
+        return cursors_.size() - 1;
+    }
+
+    // Producer side (one producer)
+
+    // Reserves n slots (n <= capacity) and returns the first sequence number. Waits while the
+    // slowest consumer still needs them.
+    size_t claim(size_t n = 1) {
+        size_t first = claimed_;
+        while (first + n - cached_gate_ > capacity_) {
+            cached_gate_ = slowestConsumer();
+            if (first + n - cached_gate_ > capacity_) std::this_thread::yield();
+        }
+        claimed_ = first + n;
+        return first;
+    }
+
+    T& operator[](size_t seq) { return items_[seq & mask_]; }
+
+    // Makes every claimed slot visible to consumers
+    void publish() {
+        published_.store(claimed_, std::memory_order_release);
+        wakeParked();
+    }
+
+    void push(T value) {
+        (*this)[claim()] = std::move(value);
+        publish();
+    }
+
+    // No claim after close(); wait_for() reports the end once a consumer saw everything
+    void close() {
+        closed_.store(true, std::memory_order_seq_cst);
+        wake_.fetch_add(1, std::memory_order_release);
+        wake_.notify_all();
+    }
+
+    // Consumer side (one thread per consumer id)
+
+    // Waits until items past next are available to this consumer and returns the end of the
+    // available batch [next, end). Returns next once closed and everything was seen.
+    size_t wait_for(size_t consumer, size_t next) {
+        Cursor& cursor = *cursors_[consumer];
+        if (cursor.cached_end > next) return cursor.cached_end;
+        while (true) {
+            for (int spins = 0; spins < kSpins; spins++) {
+                if ((cursor.cached_end = barrier(cursor)) > next) return cursor.cached_end;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                // Dependencies may still be working on the last items
+                cursor.cached_end = barrier(cursor);
+                if (cursor.cached_end > next || cursor.cached_end == published_.load(std::memory_order_acquire))
+                    return cursor.cached_end;
+            }
+            if (wait_ == SpscWait::Spin) {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t seen = wake_.load(std::memory_order_acquire);
+            // Not cleared after waking: another consumer may have set it too
+            parked_.store(true, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);       // pairs with wakeParked()
+            if (barrier(cursor) <= next && !closed_.load(std::memory_order_seq_cst))
+                wake_.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    const T& at(size_t seq) const { return items_[seq & mask_]; }
+
+    // This consumer is done with everything before end
+    void release(size_t consumer, size_t end) {
+        cursors_[consumer]->consumed.store(end, std::memory_order_release);
+        wakeParked();                                       // consumers gated on this one
+    }
+
+    // Calls f(item, seq) for each available item, batch by batch; returns once closed and
+    // everything was seen
+    template <typename F>
+    void consume(size_t consumer, F&& f) {
+        for (size_t next = 0;;) {
+            size_t end = wait_for(consumer, next);
+            if (end == next) return;
+            for (; next < end; next++) f(at(next), next);
+            release(consumer, end);
+        }
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    static constexpr int kSpins = 64;
+    static constexpr size_t kCacheLine = 64;
+
+    struct alignas(kCacheLine) Cursor {
+        std::atomic<size_t> consumed{0};                    // written by its consumer only
+        std::vector<size_t> depends_on;
+        size_t cached_end = 0;                              // consumer's last view of its barrier
+    };
+
+    size_t barrier(const Cursor& cursor) const {
+        size_t end = published_.load(std::memory_order_acquire);
+        for (size_t dep : cursor.depends_on)
+            end = std::min(end, cursors_[dep]->consumed.load(std::memory_order_acquire));
+        return end;
+    }
+
+    size_t slowestConsumer() const {
+        size_t gate = claimed_;
+        for (auto& cursor : cursors_) gate = std::min(gate, cursor->consumed.load(std::memory_order_acquire));
+        return gate;
+    }
+
+    // Same handshake as SpscRing::publish(), for any number of parked consumers
+    void wakeParked() {
+        if (wait_ != SpscWait::Park) return;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_relaxed) && parked_.exchange(false, std::memory_order_acq_rel)) {
+            wake_.fetch_add(1, std::memory_order_release);
+            wake_.notify_all();
+        }
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> items_;
+    const SpscWait wait_;
+    std::vector<std::unique_ptr<Cursor>> cursors_;
+
+    alignas(kCacheLine) std::atomic<size_t> published_{0};  // written by the producer only
+    size_t claimed_ = 0;
+    size_t cached_gate_ = 0;                                // producer's last view of the slowest cursor
+    alignas(kCacheLine) std::atomic<bool> parked_{false};
+    std::atomic<uint32_t> wake_{0};
+    std::atomic<bool> closed_{false};
+};
+
+// **************** Benchmark ***************
+
+// kItems ints from one producer to one consumer, checksum verified. The mutex version is the
+// pipeline above without the logging: std::queue + mutex + two condition variables, a
+// notify_one per item.
+
+template <typename F>
+double itemsPerSecond(long items, F&& run) {
+    auto start = std::chrono::steady_clock::now();
+    bool ok = run();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ok ? items / s : -items / s;
+}
+
+bool mutexPipeline(long items, size_t max_size) {
+    std::queue<int> queue;
+    std::mutex mtx;
+    std::condition_variable not_empty, not_full;
+    bool finished = false;
+    long long sum = 0;
+
+    std::thread cons([&] {
+        while (true) {
+            std::unique_lock<std::mutex> lock(mtx);
+            not_empty.wait(lock, [&]{ return !queue.empty() || finished; });
+            while (!queue.empty()) {
+                sum += queue.front();
+                queue.pop();
+                not_full.notify_one();
+            }
+            if (finished) break;
+        }
+    });
+    for (long i = 0; i < items; i++) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            not_full.wait(lock, [&]{ return queue.size() != max_size; });
+            queue.push(int(i));
+        }
+        not_empty.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        finished = true;
+    }
+    not_empty.notify_all();
+    cons.join();
+    return sum == (long long)items * (items - 1) / 2;
+}
+
+bool spscPipeline(long items, size_t capacity, SpscWait wait, size_t batch) {
+    SpscRing<int> ring(capacity, wait);
+    long long sum = 0;
+
+    std::thread cons([&] {
+        std::vector<int> buffer(batch);
+        int val;
+        if (batch == 1) {
+            while (ring.pop(val)) sum += val;
+            return;
+        }
+        while (true) {
+            size_t n = ring.pop_n(buffer.data(), batch);
+            for (size_t i = 0; i < n; i++) sum += buffer[i];
+            if (n) continue;
+            if (!ring.pop(val)) break;          // waits (spin / park) for the next item
+            sum += val;
+        }
+    });
+    std::vector<int> buffer(batch);
+    for (long i = 0; i < items;) {
+        if (batch == 1) {
+            ring.push(int(i++));
+            continue;
+        }
+        size_t n = std::min<size_t>(batch, items - i);
+        for (size_t k = 0; k < n; k++) buffer[k] = int(i + k);
+        for (size_t sent = 0; sent < n;) {
+            size_t pushed = ring.push_n(buffer.data() + sent, n - sent);
+            if (!pushed) std::this_thread::yield();
+            sent += pushed;
+        }
+        i += n;
+    }
+    ring.close();
+    cons.join();
+    return sum == (long long)items * (items - 1) / 2;
+}
+
+void benchPipelines() {
+    constexpr long kItems = 10000000;
+    struct {
+        const char* name;
+        std::function<bool()> run;
+    } runs[] = {
+        {"mutex + 2 cv, MAX_SIZE 10", [] { return mutexPipeline(kItems, 10); }},
+        {"mutex + 2 cv, 1024", [] { return mutexPipeline(kItems, 1024); }},
+        {"SpscRing 1024, spin", [] { return spscPipeline(kItems, 1024, SpscWait::Spin, 1); }},
+        {"SpscRing 1024, park", [] { return spscPipeline(kItems, 1024, SpscWait::Park, 1); }},
+        {"SpscRing 1024, push_n/pop_n 64", [] { return spscPipeline(kItems, 1024, SpscWait::Spin, 64); }},
+        {"SpscRing 1024, park, push_n/pop_n 64", [] { return spscPipeline(kItems, 1024, SpscWait::Park, 64); }},
+    };
+    std::cout << "pipeline                                  M items/s\n";
+    for (auto& [name, run] : runs) {
+        double rate = itemsPerSecond(kItems, run);
+        std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(11) << (rate < 0 ? -rate : rate) / 1e6 << (rate < 0 ? " !" : "") << '\n';
+    }
+}
+
+// 1 producer, 3 consumers (journal, replication, business logic) that must each see every
+// event in order: one MulticastRing vs the producer copying each event into three
+// BoundedBlockingQueues. Every consumer checks it sees seq 0, 1, 2, ... with no gap.
+// Latency is stamp → seen by the business-logic consumer (the last one when it is gated on
+// the other two), paced at one event every kPaceNs so it measures a hand-off, not a backlog.
+
+struct Event {
+    uint64_t seq;
+    uint64_t stamp_ns;
+    char payload[48];
+};
+
+struct LatencyHistogram {
+    static constexpr int kBuckets = 40;
+    uint64_t counts[kBuckets] = {};
+    uint64_t max_ns = 0;
+    uint64_t total = 0;
+
+    void add(uint64_t ns) {
+        counts[std::min(kBuckets - 1, int(std::bit_width(ns)))]++;
+        max_ns = std::max(max_ns, ns);
+        total++;
+    }
+
+    // Upper bound of the bucket holding the q-quantile
+    uint64_t percentile(double q) const {
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += counts[i];
+            if (seen >= q * total) return i == 0 ? 0 : (uint64_t{1} << i) - 1;
+        }
+        return max_ns;
+    }
+};
+
+inline uint64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct FanOutResult {
+    double seconds = 0;
+    bool ok = true;
+    LatencyHistogram latency;                   // business-logic consumer
+};
+
+// Producer loop shared by both: batches of up to batch events, paced per batch
+template <typename Send>
+void produceEvents(uint64_t items, uint64_t pace_ns, size_t batch, Send&& send) {
+    uint64_t next = steadyNs();
+    for (uint64_t i = 0; i < items;) {
+        if (pace_ns) {
+            next += pace_ns;
+            while (steadyNs() < next) std::this_thread::yield();
+        }
+        size_t n = std::min<uint64_t>(batch, items - i);
+        send(i, n);
+        i += n;
+    }
+}
+
+FanOutResult ringFanOut(uint64_t items, uint64_t pace_ns, SpscWait wait, size_t batch, bool gated) {
+    MulticastRing<Event> ring(1024, wait);
+    size_t journal = ring.add_consumer();
+    size_t replication = ring.add_consumer();
+    size_t business = gated ? ring.add_consumer({journal, replication}) : ring.add_consumer();
+    FanOutResult result;
+    std::atomic<bool> ok{true};
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> consumers;
+    for (size_t id : {journal, replication, business}) {
+        consumers.emplace_back([&, id] {
+            uint64_t expected = 0;
+            LatencyHistogram latency;
+            ring.consume(id, [&](const Event& event, size_t) {
+                if (event.seq != expected++) ok = false;
+                if (id == business) latency.add(steadyNs() - event.stamp_ns);
+            });
+            if (expected != items) ok = false;
+            if (id == business) result.latency = latency;
+        });
+    }
+    produceEvents(items, pace_ns, batch, [&](uint64_t seq, size_t n) {
+        size_t first = ring.claim(n);
+        uint64_t stamp = steadyNs();
+        for (size_t k = 0; k < n; k++) {
+            Event& event = ring[first + k];
+            event.seq = seq + k;
+            event.stamp_ns = stamp;
+        }
+        ring.publish();
+    });
+    ring.close();
+    for (auto& t : consumers) t.join();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.ok = ok;
+    return result;
+}
+
+template <QueueMode Mode>
+FanOutResult queueFanOut(uint64_t items, uint64_t pace_ns, size_t batch) {
+    std::vector<std::unique_ptr<BoundedBlockingQueue<Event, Mode>>> queues;
+    for (int q = 0; q < 3; q++) queues.push_back(std::make_unique<BoundedBlockingQueue<Event, Mode>>(1024));
+    FanOutResult result;
+    std::atomic<bool> ok{true};
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> consumers;
+    for (int q = 0; q < 3; q++) {
+        consumers.emplace_back([&, q] {
+            auto& queue = *queues[q];
+            uint64_t expected = 0;
+            LatencyHistogram latency;
+            auto seen = [&](const Event& event) {
+                if (event.seq != expected++) ok = false;
+                if (q == 2) latency.add(steadyNs() - event.stamp_ns);
+            };
+            if (batch == 1) {
+                while (auto event = queue.pop()) seen(*event);
+            } else {
+                std::vector<Event> buffer(batch);
+                while (size_t n = queue.pop_bulk(buffer.data(), batch, std::chrono::hours(1))) {
+                    for (size_t k = 0; k < n; k++) seen(buffer[k]);
+                }
+            }
+            if (expected != items) ok = false;
+            if (q == 2) result.latency = latency;
+        });
+    }
+    std::vector<Event> chunk(batch);
+    produceEvents(items, pace_ns, batch, [&](uint64_t seq, size_t n) {
+        uint64_t stamp = steadyNs();
+        for (size_t k = 0; k < n; k++) {
+            chunk[k].seq = seq + k;
+            chunk[k].stamp_ns = stamp;
+        }
+        for (auto& queue : queues) {
+            if (n == 1) queue->push(chunk[0]);
+            else queue->push_bulk(chunk.begin(), chunk.begin() + n);
+        }
+    });
+    for (auto& queue : queues) queue->shutdown();
+    for (auto& t : consumers) t.join();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.ok = ok;
+    return result;
+}
+
+void benchFanOut() {
+    constexpr uint64_t kItems = 2000000;
+    constexpr uint64_t kPaced = 20000;
+    constexpr uint64_t kPaceNs = 20000;
+    struct {
+        const char* name;
+        std::function<FanOutResult(uint64_t items, uint64_t pace_ns)> run;
+        bool paced;                             // batched rows: throughput only
+    } runs[] = {
+        {"MulticastRing, spin", [](uint64_t n, uint64_t pace) { return ringFanOut(n, pace, SpscWait::Spin, 1, false); }, true},
+        {"MulticastRing, park", [](uint64_t n, uint64_t pace) { return ringFanOut(n, pace, SpscWait::Park, 1, false); }, true},
+        {"MulticastRing, park, claim 64", [](uint64_t n, uint64_t pace) { return ringFanOut(n, pace, SpscWait::Park, 64, false); }, false},
+        {"MulticastRing, park, business gated", [](uint64_t n, uint64_t pace) { return ringFanOut(n, pace, SpscWait::Park, 1, true); }, true},
+        {"3 x BBQ Locked", [](uint64_t n, uint64_t pace) { return queueFanOut<QueueMode::Locked>(n, pace, 1); }, true},
+        {"3 x BBQ Locked, bulk 64", [](uint64_t n, uint64_t pace) { return queueFanOut<QueueMode::Locked>(n, pace, 64); }, false},
+        {"3 x BBQ SemaphoreRing", [](uint64_t n, uint64_t pace) { return queueFanOut<QueueMode::SemaphoreRing>(n, pace, 1); }, true},
+    };
+    std::cout << "1 producer → 3 consumers                M events/s   paced p50      p99    p99.9 (us)\n";
+    for (auto& [name, run, paced] : runs) {
+        FanOutResult flat = run(kItems, 0);
+        std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(11) << kItems / flat.seconds / 1e6 << (flat.ok ? " " : "!");
+        if (paced) {
+            FanOutResult r = run(kPaced, kPaceNs);
+            std::cout << std::setprecision(1);
+            for (double q : {0.5, 0.99, 0.999}) std::cout << std::setw(9) << r.latency.percentile(q) / 1e3;
+            std::cout << (r.ok ? "" : " !");
+        }
+        std::cout << '\n';
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "spsc") {
+        runSpscPipeline();
+        return 0;
+    }
+    if (mode == "bench") {
+        benchPipelines();
+        return 0;
+    }
+    if (mode == "multicast") {
+        benchFanOut();
+        return 0;
+    }
 
     std::thread prod(producer);
     std::thread cons(consumer);
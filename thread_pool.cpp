@@ -7,6 +7,44 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <future>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <cstddef>
+#include <algorithm>
+#include <numeric>
+#include <execution>
+#include <iterator>
+#include <random>
+#include <cstdint>
+#include <array>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <fstream>
+#include <latch>
+#include <limits>
+#include <ctime>
+#include <cmath>
+#include <stdexcept>
+#include <coroutine>
+#include <optional>
+#include <utility>
+#include <system_error>
+#include <ranges>
+#include <bit>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 
 // ✅ ThreadPool Interview Questions with Answers
@@ -119,6 +157,12 @@
 
 // Otherwise, discard pending tasks safely.
 
+// → ThreadPool below runs everything already queued before its workers exit; an enqueue
+//   after stop() returns EnqueueStatus::Stopped instead of dropping the task silently.
+//   Continuations (strand batches, resumed coroutines, graph successors) are still
+//   accepted while workers drain, and run in the caller once they are gone.
+//   ThreadPoolOptions::max_queue / overflow bound the queue itself (OverflowPolicy).
+
 // 1️⃣5️⃣ How does this compare with std::async?
 // std::async manages threads for you → simpler API.
 
@@ -129,101 +173,3679 @@
 
 // Tasks should then be comparable or wrapped in a structure that supports priority comparison.
 
+// → ThreadPool below: High/Normal/Low lanes + an earliest-deadline-first lane (TaskLanes),
+//   with starvation protection for the low lanes.
+
 // 1️⃣7️⃣ Can you scale ThreadPool dynamically?
 // Yes → Add an addThread() function to increase pool size.
 
 // Requires additional synchronization to manage thread lifecycles.
 
+// → ThreadPoolOptions below: min/max threads, grows on queue depth / backlog age,
+//   retires workers idle for longer than idle_timeout.
 
 
-// template<typename F, typename... Args>
-// auto enqueue(F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
-//     using return_type = decltype(f(args...));
 
-//     auto task = std::make_shared<std::packaged_task<return_type()>>(
-//         std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-//     );
+// **************** Task / pooled future state ***************
 
-//     std::future<return_type> res = task->get_future();
+// std::function<void()> heap-allocates for any capture bigger than ~2 pointers and is
+// copyable, so it cannot hold a std::promise. Task is move-only and keeps callables up
+// to kInlineSize bytes inside the object itself; bigger ones still go to the heap.
+class Task {
+public:
+    static constexpr size_t kInlineSize = 48;
+
+    Task() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& f) {
+        using Fn = std::decay_t<F>;
+        if constexpr (fitsInline<Fn>()) {
+            ::new (static_cast<void*>(storage_)) Fn(std::forward<F>(f));
+            ops_ = &kInlineOps<Fn>;
+        } else {
+            ::new (static_cast<void*>(storage_)) Fn*(new Fn(std::forward<F>(f)));
+            ops_ = &kHeapOps<Fn>;
+        }
+    }
 
-//     {
-//         std::lock_guard<std::mutex> lock(queue_mutex_);
-//         tasks_queue_.emplace([task](){ (*task)(); });
-//     }
-//     queue_cv_.notify_one();
-//     return res;
-// }
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            ops_ = other.ops_;
+            if (ops_) {
+                ops_->move(storage_, other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops_->invoke(storage_); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+private:
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src);     // move-construct dst, destroy src
+        void (*destroy)(void*);
+    };
+
+    template <typename Fn>
+    static constexpr bool fitsInline() {
+        return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<Fn>;
+    }
+
+    template <typename Fn>
+    static constexpr Ops kInlineOps{
+        [](void* p) { (*static_cast<Fn*>(p))(); },
+        [](void* dst, void* src) {
+            ::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        },
+        [](void* p) { static_cast<Fn*>(p)->~Fn(); },
+    };
+
+    template <typename Fn>
+    static constexpr Ops kHeapOps{
+        [](void* p) { (**static_cast<Fn**>(p))(); },
+        [](void* dst, void* src) { ::new (dst) Fn*(*static_cast<Fn**>(src)); },
+        [](void* p) { delete *static_cast<Fn**>(p); },
+    };
+
+    void reset() {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops* ops_ = nullptr;
+};
+
+// Per-thread free list of fixed-size blocks. The shared state of a promise is created by
+// the submitting thread but often released by a worker, so blocks drift between threads:
+// a thread with too many hands a batch to the central list, a thread with none takes a
+// batch back. One mutex acquisition per kBatch blocks instead of one malloc per block.
+template <size_t Size, size_t Align>
+class FreeListCache {
+    struct Node { Node* next; };
+
+    static constexpr size_t kBlockSize = Size < sizeof(Node) ? sizeof(Node) : Size;
+    static constexpr size_t kBatch = 64;
+
+    struct Central {
+        std::mutex mtx;
+        std::vector<Node*> batches;     // each entry is a chain of kBatch blocks
+
+        ~Central() {
+            for (Node* chain : batches) freeChain(chain);
+        }
+    };
+
+    Node* head_ = nullptr;
+    size_t cached_ = 0;
+
+    static Central& central() {
+        static Central c;
+        return c;
+    }
+
+    static void* allocateBlock() {
+        if constexpr (Align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            return ::operator new(kBlockSize, std::align_val_t(Align));
+        else
+            return ::operator new(kBlockSize);
+    }
+
+    static void freeBlock(void* p) {
+        if constexpr (Align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            ::operator delete(p, std::align_val_t(Align));
+        else
+            ::operator delete(p);
+    }
+
+    static void freeChain(Node* node) {
+        while (node) {
+            Node* next = node->next;
+            freeBlock(node);
+            node = next;
+        }
+    }
 
-class ThreadPool{
 public:
-    explicit ThreadPool(int num_threads){
-        stop_ = false;
-        for(int i = 0; i < num_threads; i++){
-            threads_.emplace_back(std::thread([this]{
-                while(true){
+    static FreeListCache& local() {
+        thread_local FreeListCache cache;
+        return cache;
+    }
 
-                    std::function<void()> task;
+    void* allocate() {
+        if (!head_) {
+            Central& c = central();
+            std::lock_guard lock(c.mtx);
+            if (c.batches.empty()) return allocateBlock();
+            head_ = c.batches.back();
+            c.batches.pop_back();
+            cached_ = kBatch;
+        }
+        Node* node = head_;
+        head_ = node->next;
+        cached_--;
+        return node;
+    }
 
-                    {
-                        std::unique_lock<std::mutex> lock(queue_mutex_);
-                        queue_cv_.wait(lock, [this]{
-                            return !tasks_queue_.empty() || stop_;
-                        });
+    void deallocate(void* p) {
+        head_ = ::new (p) Node{head_};
+        if (++cached_ < 2 * kBatch) return;
 
-                        if(stop_ && tasks_queue_.empty())
-                            return;
+        // Keep kBatch locally, give the other kBatch away
+        Node* tail = head_;
+        for (size_t i = 1; i < kBatch; i++) tail = tail->next;
+        Node* chain = tail->next;
+        tail->next = nullptr;
+        cached_ = kBatch;
 
-                        task = tasks_queue_.front();
-                        tasks_queue_.pop();
-                    }
+        Central& c = central();
+        std::lock_guard lock(c.mtx);
+        c.batches.push_back(chain);
+    }
 
-                    task();
-                }
-            }));
+    ~FreeListCache() {
+        freeChain(head_);
+    }
+};
+
+template <typename T>
+struct PoolAllocator {
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n != 1) return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        return static_cast<T*>(FreeListCache<sizeof(T), alignof(T)>::local().allocate());
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n != 1) {
+            ::operator delete(p, std::align_val_t(alignof(T)));
+            return;
         }
+        FreeListCache<sizeof(T), alignof(T)>::local().deallocate(p);
     }
 
-    void enqueue(std::function<void()> task){
-        if(!stop_){
-            {
-                std::lock_guard<std::mutex> lock(queue_mutex_);
-                tasks_queue_.push(std::move(task));
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const { return true; }
+};
+
+// Replaces make_shared<packaged_task>: the promise (and its shared state from the
+// free list) travels inside the Task itself.
+template <typename F, typename... Args>
+auto packageTask(F&& f, Args&&... args) {
+    using return_type = std::invoke_result_t<F, Args...>;
+
+    std::promise<return_type> promise(std::allocator_arg, PoolAllocator<return_type>{});
+    std::future<return_type> res = promise.get_future();
+
+    Task task([promise = std::move(promise), f = std::forward<F>(f),
+               ... args = std::forward<Args>(args)]() mutable {
+        try {
+            if constexpr (std::is_void_v<return_type>) {
+                std::invoke(f, args...);
+                promise.set_value();
+            } else {
+                promise.set_value(std::invoke(f, args...));
             }
-            queue_cv_.notify_one();
+        } catch (...) {
+            promise.set_exception(std::current_exception());
         }
+    });
+    return std::make_pair(std::move(task), std::move(res));
+}
+
+// Growable circular buffer. Unlike std::deque it never gives memory back,
+// so a pool in steady state does no allocations for its queue either.
+template <typename T>
+class RingQueue {
+    std::vector<T> buffer_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+    size_t first_capacity_ = 64;
+
+    void grow() {
+        std::vector<T> bigger(buffer_.empty() ? first_capacity_ : buffer_.size() * 2);
+        for (size_t i = 0; i < size_; i++)
+            bigger[i] = std::move(buffer_[(head_ + i) & (buffer_.size() - 1)]);
+        buffer_ = std::move(bigger);
+        head_ = 0;
     }
 
-    void stop(){
+public:
+    RingQueue() = default;
+
+    // Power of two. Nothing is allocated until the first push.
+    explicit RingQueue(size_t first_capacity) : first_capacity_(first_capacity) {}
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    T& front() { return buffer_[head_]; }
+    T& back() { return buffer_[(head_ + size_ - 1) & (buffer_.size() - 1)]; }
+
+    void push(T item) {
+        if (size_ == buffer_.size()) grow();
+        buffer_[(head_ + size_) & (buffer_.size() - 1)] = std::move(item);
+        size_++;
+    }
+
+    void pop() {
+        buffer_[head_] = T{};           // release captures now, not when the slot is reused
+        head_ = (head_ + 1) & (buffer_.size() - 1);
+        size_--;
+    }
+
+    void pop_back() {
+        back() = T{};
+        size_--;
+    }
+};
+
+// Already admitted work (continuations) must not be blocked or rejected by a bounded pool
+template <typename Pool>
+void enqueueContinuation(Pool& pool, Task task) {
+    if constexpr (requires { pool.enqueue_continuation(std::move(task)); }) {
+        pool.enqueue_continuation(std::move(task));
+    } else {
+        pool.enqueue(std::move(task));
+    }
+}
+
+// co_await pool.schedule(): the rest of the coroutine runs on one of the pool's workers
+template <typename Pool>
+struct ScheduleAwaiter {
+    Pool& pool;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { enqueueContinuation(pool, Task([handle] { handle.resume(); })); }
+    void await_resume() const noexcept {}
+};
+
+// **************** Strands ***************
+
+// pool.strand(key).post(fn): tasks posted with the same key run one at a time, in post
+// order, on whichever worker is free; different keys run in parallel. No thread and no
+// mutex per key, and a key only exists in the map while it has work queued.
+//  - post: lock the key's shard, append; if the key was idle, enqueue one drain task
+//  - drain: take up to kStrandBatch tasks under the shard lock, run them unlocked, then
+//    erase the key (nothing left) or re-enqueue itself at the back of the pool, so a
+//    hot key can't hold on to a worker
+// Keys are hashed to 64 bits; keys with equal hashes share a strand (still in order).
+
+template <typename Pool>
+class StrandMap {
+public:
+    static constexpr size_t kShards = 256;
+    static constexpr size_t kStrandBatch = 32;
+
+    explicit StrandMap(Pool& pool) : pool_(pool) {}
+
+    StrandMap(const StrandMap&) = delete;
+    StrandMap& operator=(const StrandMap&) = delete;
+
+    void post(uint64_t key, Task task) {
+        Shard& shard = shards_[(key * 0x9E3779B97F4A7C15ULL) >> 56];
+        StrandState* state;
         {
-            std::lock_guard<std::mutex> lock(queue_mutex_);
-            stop_ = true;
+            std::lock_guard lock(shard.mtx);
+            state = &shard.strands.try_emplace(key).first->second;
+            state->push(std::move(task));
+            if (state->scheduled)
+                return;                     // its drain task will get to it
+            state->scheduled = true;
         }
+        schedule(shard, key, state);
+    }
 
-        queue_cv_.notify_all();
+private:
+    // Most keys only ever hold one task at a time: that one lives in the node itself,
+    // a queue is only allocated for a key that gets a backlog
+    struct StrandState {
+        Task first;                         // oldest task, if set
+        std::unique_ptr<RingQueue<Task>> rest;
+        bool scheduled = false;
+
+        bool empty() const { return !first && (!rest || rest->empty()); }
+
+        void push(Task task) {
+            if (empty()) {
+                first = std::move(task);
+                return;
+            }
+            if (!rest) rest = std::make_unique<RingQueue<Task>>(4);
+            rest->push(std::move(task));
+        }
 
-        for(auto &t : threads_){
-            if(t.joinable())
-                t.join();
+        Task pop() {
+            if (first) return std::move(first);
+            Task task = std::move(rest->front());
+            rest->pop();
+            return task;
         }
+    };
+
+    // unordered_map nodes don't move, and only the drain erases its own key.
+    // Nodes come from the pool's free lists: a cold key is inserted and erased per post.
+    using Strands = std::unordered_map<uint64_t, StrandState, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                                       PoolAllocator<std::pair<const uint64_t, StrandState>>>;
+
+    struct alignas(64) Shard {
+        std::mutex mtx;
+        Strands strands;
+    };
+
+    void schedule(Shard& shard, uint64_t key, StrandState* state) {
+        enqueueContinuation(pool_, Task([this, &shard, key, state] { drain(shard, key, state); }));
     }
 
-    ~ThreadPool(){
-        stop();
+    // Batches of kStrandBatch, then back of the queue so one hot key can't hold a
+    // worker. Once the pool is stopping the backlog is finished right here instead.
+    void drain(Shard& shard, uint64_t key, StrandState* state) {
+        std::array<Task, kStrandBatch> batch;
+        do {
+            size_t n = 0;
+            {
+                std::lock_guard lock(shard.mtx);
+                for (; n < kStrandBatch && !state->empty(); n++)
+                    batch[n] = state->pop();
+            }
+
+            for (size_t i = 0; i < n; i++) {
+                batch[i]();
+                batch[i] = Task{};
+            }
+
+            {
+                std::lock_guard lock(shard.mtx);
+                if (state->empty()) {
+                    shard.strands.erase(key);
+                    return;
+                }
+            }
+        } while (pool_.stopping());
+        schedule(shard, key, state);
     }
 
+    Pool& pool_;
+    std::array<Shard, kShards> shards_;
+};
+
+template <typename Pool>
+class Strand {
+public:
+    Strand(StrandMap<Pool>& map, uint64_t key) : map_(&map), key_(key) {}
+
+    void post(Task task) { map_->post(key_, std::move(task)); }
+
 private:
-    std::vector<std::thread> threads_;
-    std::queue<std::function<void()>> tasks_queue_;
-    std::mutex queue_mutex_;
-    std::condition_variable queue_cv_;
-    bool stop_;
+    StrandMap<Pool>* map_;
+    uint64_t key_;
 };
 
-void printFunc(int counter){
-    std::cout << " Printing Function : " << counter << std::endl;
+// **************** Tracing ***************
+
+// Which worker ran what, and when: a per-task timeline for chrome://tracing / ui.perfetto.dev.
+//   TaskTracer::start();
+//   pool.enqueue(Task(parse), "parse");         // labels must outlive the dump (literals)
+//   ...
+//   TaskTracer::stop();
+//   TaskTracer::dump("trace.json");
+// Each thread records into its own ring (single writer, one release store per event, no
+// shared counter, not even for task ids); the registry mutex is taken once per thread
+// and by dump(). A full ring overwrites its oldest events.
+// Per task: an enqueue slice + flow arrow on the submitting thread, a begin/end slice on
+// the worker. Compiled out with -DTHREAD_POOL_TRACING=0; compiled in but not started it
+// costs one relaxed load per hook.
+
+#ifndef THREAD_POOL_TRACING
+#define THREAD_POOL_TRACING 1
+#endif
+
+#if THREAD_POOL_TRACING
+
+class TaskTracer {
+public:
+    // Ring size for threads that record their first event after this call
+    static void start(size_t events_per_thread = size_t{1} << 16) {
+        capacity_.store(std::bit_ceil(std::max<size_t>(events_per_thread, 2)), std::memory_order_relaxed);
+        start_ns_.store(nowNs(), std::memory_order_relaxed);
+        enabled_.store(true, std::memory_order_release);
+    }
+
+    static void stop() { enabled_.store(false, std::memory_order_release); }
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Shows up as the track name; a thread that never records costs nothing
+    static void nameThread(std::string name) {
+        threadName() = std::move(name);
+        if (Buffer* buffer = localBuffer()) {
+            std::lock_guard lock(registry_mutex_);
+            buffer->name = threadName();
+        }
+    }
+
+    // Hooks used by the pools; Stamp is the per-task TaskStamp carried through the queue
+    template <typename Stamp>
+    static void enqueued(Stamp& stamp, const char* label) {
+        if (!enabled()) return;
+        Buffer& buffer = local();
+        stamp.trace_id = (uint64_t(buffer.tid) << 40) | ++buffer.next_id;
+        stamp.label = label;
+        buffer.record(Phase::Enqueue, stamp.trace_id, label);
+    }
+
+    template <typename Stamp>
+    static void begin(const Stamp& stamp) {
+        if (stamp.trace_id != 0) local().record(Phase::Begin, stamp.trace_id, stamp.label);
+    }
+
+    template <typename Stamp>
+    static void end(const Stamp& stamp) {
+        if (stamp.trace_id != 0) local().record(Phase::End, stamp.trace_id, stamp.label);
+    }
+
+    // Chrome trace event format. Meant to be called after stop(); while threads are still
+    // recording, events that may have been overwritten during the copy are left out.
+    static size_t dump(std::ostream& os) {
+        std::lock_guard lock(registry_mutex_);
+        uint64_t since = start_ns_.load(std::memory_order_relaxed);
+        size_t written = 0;
+        auto sep = [&] { os << (written++ ? ",\n" : "\n"); };
+        auto ts = [&](uint64_t ns) { return double(ns - std::min(ns, since)) / 1000; };
+
+        os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        for (auto& buffer : buffers_) {
+            sep();
+            os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+               << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+
+            for (const Event& e : buffer->snapshot()) {
+                if (e.ns < since) continue;
+                const char* name = e.label ? e.label : "task";
+                std::string common = ",\"cat\":\"task\",\"pid\":1,\"tid\":" + std::to_string(buffer->tid);
+                sep();
+                if (e.phase == Phase::Enqueue) {
+                    os << "{\"name\":\"enqueue " << name << "\",\"ph\":\"X\",\"dur\":0.001,\"ts\":" << ts(e.ns)
+                       << common << "},\n{\"name\":\"queued\",\"ph\":\"s\",\"id\":" << e.id
+                       << ",\"ts\":" << ts(e.ns) << common << "}";
+                } else if (e.phase == Phase::Begin) {
+                    os << "{\"name\":\"" << name << "\",\"ph\":\"B\",\"ts\":" << ts(e.ns) << common
+                       << ",\"args\":{\"id\":" << e.id << "}},\n{\"name\":\"queued\",\"ph\":\"f\",\"bp\":\"e\",\"id\":"
+                       << e.id << ",\"ts\":" << ts(e.ns) << common << "}";
+                } else {
+                    os << "{\"name\":\"" << name << "\",\"ph\":\"E\",\"ts\":" << ts(e.ns) << common << "}";
+                }
+            }
+        }
+        os << "\n]}\n";
+        return written;
+    }
+
+    static bool dump(const std::string& path) {
+        std::ofstream file(path);
+        dump(file);
+        return bool(file);
+    }
+
+private:
+    enum class Phase : uint8_t { Enqueue, Begin, End };
+
+    struct Event {
+        uint64_t ns;
+        uint64_t id;
+        const char* label;
+        Phase phase;
+    };
+
+    struct Buffer {
+        std::unique_ptr<Event[]> events;
+        size_t mask;
+        std::atomic<uint64_t> head{0};      // events ever recorded; only the owner writes it
+        uint64_t next_id = 0;
+        uint32_t tid;
+        std::string name;
+
+        void record(Phase phase, uint64_t id, const char* label) {
+            uint64_t h = head.load(std::memory_order_relaxed);
+            events[h & mask] = {nowNs(), id, label, phase};
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        std::vector<Event> snapshot() const {
+            uint64_t end = head.load(std::memory_order_acquire);
+            uint64_t begin = end - std::min<uint64_t>(end, mask + 1);
+            std::vector<Event> copy;
+            for (uint64_t i = begin; i < end; i++) copy.push_back(events[i & mask]);
+
+            // The writer may have lapped us while copying: drop what it could have overwritten
+            uint64_t now = head.load(std::memory_order_acquire);
+            uint64_t valid = now - std::min<uint64_t>(now, mask + 1);
+            if (valid > begin) copy.erase(copy.begin(), copy.begin() + std::min<uint64_t>(valid - begin, copy.size()));
+            return copy;
+        }
+    };
+
+    static uint64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static std::string& threadName() {
+        static thread_local std::string name;
+        return name;
+    }
+
+    static Buffer*& localBuffer() {
+        static thread_local Buffer* buffer = nullptr;
+        return buffer;
+    }
+
+    static Buffer& local() {
+        Buffer*& buffer = localBuffer();
+        if (!buffer) {
+            auto fresh = std::make_unique<Buffer>();
+            size_t capacity = capacity_.load(std::memory_order_relaxed);
+            fresh->events = std::make_unique<Event[]>(capacity);
+            fresh->mask = capacity - 1;
+
+            std::lock_guard lock(registry_mutex_);
+            fresh->tid = uint32_t(buffers_.size() + 1);
+            fresh->name = threadName().empty() ? "thread " + std::to_string(fresh->tid) : threadName();
+            buffer = fresh.get();
+            buffers_.push_back(std::move(fresh));       // outlives the thread, so dump() still sees it
+        }
+        return *buffer;
+    }
+
+    inline static std::atomic<bool> enabled_{false};
+    inline static std::atomic<size_t> capacity_{size_t{1} << 16};
+    inline static std::atomic<uint64_t> start_ns_{0};
+    inline static std::mutex registry_mutex_;
+    inline static std::vector<std::unique_ptr<Buffer>> buffers_;
+};
+
+#else
+
+struct TaskTracer {
+    static void start(size_t = 0) {}
+    static void stop() {}
+    static bool enabled() { return false; }
+    static void nameThread(std::string) {}
+    template <typename Stamp> static void enqueued(Stamp&, const char*) {}
+    template <typename Stamp> static void begin(const Stamp&) {}
+    template <typename Stamp> static void end(const Stamp&) {}
+    static size_t dump(std::ostream&) { return 0; }
+    static bool dump(const std::string&) { return false; }
+};
+
+#endif
+
+// **************** Metrics ***************
+
+// Counters and latency histograms for ThreadPool, read with pool.metrics().
+// Compiled out entirely with -DTHREAD_POOL_METRICS=0 (every hook below becomes an
+// empty inline function and TaskStamp an empty member).
+//  - per worker, cache-line padded, single writer → plain load+store, no lock prefix
+//  - timestamps are raw TSC ticks, converted to ns only in the snapshot. Even rdtsc is
+//    7-20ns, so only 1 task in THREAD_POOL_METRICS_SAMPLE is timed (the submitter
+//    decides, the worker times the tasks that arrive stamped); counts are exact
+//  - queue_mutex_ wait: try_lock first, the clock is only read when that fails
+//  - histograms are log2 buckets of ticks, so percentiles are bucket upper bounds
+
+#ifndef THREAD_POOL_METRICS
+#define THREAD_POOL_METRICS 1
+#endif
+#ifndef THREAD_POOL_METRICS_SAMPLE
+#define THREAD_POOL_METRICS_SAMPLE 16
+#endif
+
+// Per-task bookkeeping carried through the queue next to the Task
+struct TaskStamp {
+#if THREAD_POOL_METRICS
+    uint64_t ticks = 0;                 // 0: not sampled
+#endif
+#if THREAD_POOL_TRACING
+    uint64_t trace_id = 0;              // 0: tracer was off at enqueue
+    const char* label = nullptr;
+#endif
+};
+
+constexpr size_t kMetricBuckets = 48;
+
+struct ThreadPoolMetrics {
+    struct Histogram {
+        std::array<uint64_t, kMetricBuckets> buckets{};     // bucket i: [2^(i-1), 2^i) ticks
+        uint64_t sum_ticks = 0;
+        double ns_per_tick = 1;
+
+        uint64_t count() const { return std::accumulate(buckets.begin(), buckets.end(), uint64_t{0}); }
+
+        double mean_ns() const {
+            uint64_t n = count();
+            return n ? sum_ticks * ns_per_tick / n : 0;
+        }
+
+        double percentile_ns(double p) const {
+            uint64_t n = count(), seen = 0;
+            for (size_t i = 0; i < kMetricBuckets; i++) {
+                seen += buckets[i];
+                if (seen > 0 && seen >= p * n) return double(uint64_t{1} << i) * ns_per_tick;
+            }
+            return 0;
+        }
+
+        Histogram& operator+=(const Histogram& other) {
+            for (size_t i = 0; i < kMetricBuckets; i++) buckets[i] += other.buckets[i];
+            sum_ticks += other.sum_ticks;
+            return *this;
+        }
+    };
+
+    struct Worker {
+        uint64_t tasks_run = 0;
+        double busy_ms = 0;             // tasks_run * sampled mean run time
+        double lock_wait_ms = 0;
+    };
+
+    bool enabled = false;
+    size_t threads = 0;
+    uint64_t tasks_submitted = 0;
+    uint64_t tasks_run = 0;
+    size_t queue_depth = 0;
+    size_t queue_high_water = 0;
+    uint64_t lock_waits = 0;            // acquisitions of queue_mutex_ that found it taken
+    double lock_wait_ms = 0;
+    Histogram queue_wait;               // enqueue → start, sampled
+    Histogram run_time;                 // sampled
+    std::vector<Worker> workers;        // per worker slot: a retired worker's counts stay in its
+                                        // slot and the next worker started keeps adding to them
+
+    void print(std::ostream& os) const {
+        if (!enabled) {
+            os << "metrics compiled out (THREAD_POOL_METRICS=0)\n";
+            return;
+        }
+        os << std::fixed << std::setprecision(2)
+           << "threads " << threads << ", submitted " << tasks_submitted << ", run " << tasks_run
+           << ", queue depth " << queue_depth << " (high water " << queue_high_water << ")\n"
+           << "queue_mutex_ waits " << lock_waits << ", " << lock_wait_ms << " ms waiting\n";
+        auto row = [&](const char* name, const Histogram& h) {
+            os << name << " mean " << h.mean_ns() << " ns, p50 <" << h.percentile_ns(0.5)
+               << " ns, p99 <" << h.percentile_ns(0.99) << " ns, max <" << h.percentile_ns(1) << " ns\n";
+        };
+        row("queue wait:", queue_wait);
+        row("run time:  ", run_time);
+        for (size_t i = 0; i < workers.size(); i++)
+            os << "  worker " << i << ": " << workers[i].tasks_run << " tasks, busy " << workers[i].busy_ms
+               << " ms, lock wait " << workers[i].lock_wait_ms << " ms\n";
+    }
+};
+
+#if THREAD_POOL_METRICS
+
+inline uint64_t metricTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Measured once, on the first snapshot (assumes an invariant TSC)
+inline double nsPerMetricTick() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double ratio = [] {
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = metricTicks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t c1 = metricTicks();
+        auto t1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / double(c1 - c0);
+    }();
+    return ratio;
+#else
+    return 1;
+#endif
+}
+
+// Only the owning thread writes a single-writer counter; snapshots read it concurrently
+inline void bump(std::atomic<uint64_t>& counter, uint64_t by = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+class LatencyHistogram {
+public:
+    void record(uint64_t ticks) {
+        bump(buckets_[std::min<size_t>(std::bit_width(ticks), kMetricBuckets - 1)]);
+        bump(sum_ticks_, ticks);
+    }
+
+    void addTo(ThreadPoolMetrics::Histogram& out) const {
+        for (size_t i = 0; i < kMetricBuckets; i++)
+            out.buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+        out.sum_ticks += sum_ticks_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kMetricBuckets> buckets_{};
+    std::atomic<uint64_t> sum_ticks_{0};
+};
+
+// One per worker thread
+struct alignas(64) WorkerMetrics {
+    std::atomic<uint64_t> tasks_run{0};
+    std::atomic<uint64_t> lock_waits{0};
+    std::atomic<uint64_t> lock_wait_ticks{0};
+    LatencyHistogram queue_wait;
+    LatencyHistogram run_time;
+
+    void lock(std::unique_lock<std::mutex>& lock) {
+        if (lock.try_lock()) return;
+        uint64_t start = metricTicks();
+        lock.lock();
+        bump(lock_waits);
+        bump(lock_wait_ticks, metricTicks() - start);
+    }
+
+    TaskStamp taskStarted(TaskStamp queued) {
+        if (queued.ticks == 0) return {};
+        uint64_t now = metricTicks();
+        queue_wait.record(now - std::min(now, queued.ticks));
+        return {now};
+    }
+
+    void taskFinished(TaskStamp started) {
+        bump(tasks_run);
+        if (started.ticks != 0) run_time.record(metricTicks() - started.ticks);
+    }
+};
+
+// Submitting side: many writers, but everything except the lock wait is updated
+// with queue_mutex_ held, so only that pair needs a real read-modify-write.
+struct alignas(64) SubmitMetrics {
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> high_water{0};
+    alignas(64) std::atomic<uint64_t> lock_waits{0};
+    std::atomic<uint64_t> lock_wait_ticks{0};
+
+    // Called once per task submitted
+    TaskStamp stamp() const {
+        static thread_local uint32_t submitted_here = 0;
+        if (submitted_here++ % THREAD_POOL_METRICS_SAMPLE != 0) return {};
+        return {metricTicks()};
+    }
+
+    void lock(std::unique_lock<std::mutex>& lock) {
+        if (lock.try_lock()) return;
+        uint64_t start = metricTicks();
+        lock.lock();
+        lock_waits.fetch_add(1, std::memory_order_relaxed);
+        lock_wait_ticks.fetch_add(metricTicks() - start, std::memory_order_relaxed);
+    }
+
+    // Caller holds queue_mutex_
+    void pushed(size_t n, size_t depth) {
+        bump(submitted, n);
+        if (depth > high_water.load(std::memory_order_relaxed))
+            high_water.store(depth, std::memory_order_relaxed);
+    }
+};
+
+#else
+
+struct WorkerMetrics {
+    void lock(std::unique_lock<std::mutex>& lock) { lock.lock(); }
+    TaskStamp taskStarted(TaskStamp) { return {}; }
+    void taskFinished(TaskStamp) {}
+};
+
+struct SubmitMetrics {
+    TaskStamp stamp() const { return {}; }
+    void lock(std::unique_lock<std::mutex>& lock) { lock.lock(); }
+    void pushed(size_t, size_t) {}
+};
+
+#endif
+
+// **************** Priority / deadline lanes ***************
+
+// tasks_queue_ of ThreadPool. Instead of one FIFO:
+//  - a deadline lane, earliest deadline first, always served before the others
+//  - High / Normal / Low FIFO lanes, served in that order
+// Starvation protection: every time a non-empty lane is passed over its counter goes up;
+// once it reaches starvation_limit that lane is served next (lowest lane checked first).
+// So under saturation a Low task gets at least 1 slot in starvation_limit + 1.
+// Continuations (ThreadPool::enqueue_continuation) get a lane of their own between High
+// and Normal: already admitted work goes ahead of new Normal work, and dropOldest()
+// never picks from it.
+
+enum class Priority { High, Normal, Low };
+
+class TaskLanes {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TaskLanes(size_t starvation_limit) : starvation_limit_(starvation_limit) {}
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    void push(Task task, Priority priority, TaskStamp stamp = {}) {
+        lanes_[laneOf(priority)].push({std::move(task), stamp});
+        size_++;
+    }
+
+    void pushContinuation(Task task, TaskStamp stamp = {}) {
+        lanes_[kContinuationLane].push({std::move(task), stamp});
+        size_++;
+    }
+
+    void push(Task task, Clock::time_point deadline, TaskStamp stamp = {}) {
+        deadline_heap_.push_back({deadline, deadline_seq_++, std::move(task), stamp});
+        std::push_heap(deadline_heap_.begin(), deadline_heap_.end(), Later{});
+        size_++;
+    }
+
+    // Oldest task of the least urgent lane: Low, Normal, High, and only then the deadline
+    // lane (earliest deadline, most likely already late). Continuations are never dropped:
+    // an empty Task if they are all that is queued.
+    Task dropOldest() {
+        for (size_t l = kLanes; l-- > 0;) {
+            if (l != kContinuationLane && !lanes_[l].empty()) {
+                size_--;
+                Task task = std::move(lanes_[l].front().task);
+                lanes_[l].pop();
+                return task;
+            }
+        }
+        if (deadline_heap_.empty()) return {};
+        size_--;
+        std::pop_heap(deadline_heap_.begin(), deadline_heap_.end(), Later{});
+        Task task = std::move(deadline_heap_.back().task);
+        deadline_heap_.pop_back();
+        return task;
+    }
+
+    // Precondition: !empty(). stamp ← what the task was pushed with.
+    Task pop(TaskStamp& stamp) {
+        size_--;
+
+        if (!deadline_heap_.empty()) {
+            bool starving = false;
+            for (size_t l = 0; l < kLanes; l++)
+                starving |= !lanes_[l].empty() && passed_over_[l] >= starvation_limit_;
+
+            if (!starving) {
+                passOverAllBut(kLanes);
+                std::pop_heap(deadline_heap_.begin(), deadline_heap_.end(), Later{});
+                Task task = std::move(deadline_heap_.back().task);
+                stamp = deadline_heap_.back().stamp;
+                deadline_heap_.pop_back();
+                return task;
+            }
+        }
+
+        size_t chosen = kLanes;
+        for (size_t l = kLanes; l-- > 0;) {
+            if (!lanes_[l].empty() && passed_over_[l] >= starvation_limit_) {
+                chosen = l;
+                break;
+            }
+        }
+        if (chosen == kLanes) {
+            chosen = 0;
+            while (lanes_[chosen].empty()) chosen++;
+        }
+
+        passOverAllBut(chosen);
+        passed_over_[chosen] = 0;
+        Task task = std::move(lanes_[chosen].front().task);
+        stamp = lanes_[chosen].front().stamp;
+        lanes_[chosen].pop();
+        return task;
+    }
+
+private:
+    static constexpr size_t kLanes = 4;             // High, continuations, Normal, Low
+    static constexpr size_t kContinuationLane = 1;
+
+    static size_t laneOf(Priority priority) {
+        return priority == Priority::High ? 0 : static_cast<size_t>(priority) + 1;
+    }
+
+    struct DeadlineTask {
+        Clock::time_point deadline;
+        uint64_t seq;               // FIFO among equal deadlines
+        Task task;
+        [[no_unique_address]] TaskStamp stamp;
+    };
+
+    struct Queued {
+        Task task;
+        [[no_unique_address]] TaskStamp stamp;
+    };
+
+    struct Later {
+        bool operator()(const DeadlineTask& a, const DeadlineTask& b) const {
+            return a.deadline != b.deadline ? a.deadline > b.deadline : a.seq > b.seq;
+        }
+    };
+
+    void passOverAllBut(size_t chosen) {
+        for (size_t l = 0; l < kLanes; l++) {
+            if (l != chosen && !lanes_[l].empty())
+                passed_over_[l]++;
+        }
+    }
+
+    std::array<RingQueue<Queued>, kLanes> lanes_;
+    std::array<size_t, kLanes> passed_over_{};
+    std::vector<DeadlineTask> deadline_heap_;
+    uint64_t deadline_seq_ = 0;
+    size_t size_ = 0;
+    const size_t starvation_limit_;
+};
+
+// **************** Idle policy / EventCount ***************
+
+// What a worker does when the queue is empty: spin (pause instruction) for spin_iterations
+// checks, then std::this_thread::yield() for yield_iterations checks, then park.
+// Spinning trades CPU for wakeup latency on bursty traffic. Default = park right away.
+struct IdlePolicy {
+    unsigned spin_iterations = 0;
+    unsigned yield_iterations = 0;
+};
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
 }
 
-int main(){
+// Parking lot that costs nothing to notify when nobody is parked. A waiter registers
+// (prepareWait), re-checks its condition, and only then blocks; notify() first looks at
+// the waiter count and returns without taking the mutex or making a syscall if it is zero.
+//   state_ = epoch << 32 | waiters
+// Waiter: prepareWait() (seq_cst RMW) then reads the condition. Notifier: publishes the
+// condition (seq_cst) then reads state_. One of them always sees the other.
+class EventCount {
+public:
+    using Key = uint32_t;
+
+    Key prepareWait() {
+        return static_cast<Key>(state_.fetch_add(1) >> 32);
+    }
+
+    void cancelWait() {
+        state_.fetch_sub(1);
+    }
+
+    void wait(Key key) {
+        std::unique_lock lock(mtx_);
+        cv_.wait(lock, [&] { return epoch() != key; });
+        state_.fetch_sub(1);
+    }
+
+    // false → timed out without a notify
+    template <typename Rep, typename Period>
+    bool wait_for(Key key, std::chrono::duration<Rep, Period> timeout) {
+        std::unique_lock lock(mtx_);
+        bool notified = cv_.wait_for(lock, timeout, [&] { return epoch() != key; });
+        state_.fetch_sub(1);
+        return notified;
+    }
+
+    // Wake up to n parked waiters
+    void notify(size_t n = 1) {
+        size_t waiters = static_cast<uint32_t>(state_.load());
+        if (waiters == 0 || n == 0)
+            return;
+        {
+            std::lock_guard lock(mtx_);
+            state_.fetch_add(uint64_t(1) << 32);
+        }
+        if (n >= waiters) {
+            cv_.notify_all();
+        } else {
+            for (size_t i = 0; i < n; i++) cv_.notify_one();
+        }
+    }
+
+    void notifyAll() {
+        notify(std::numeric_limits<size_t>::max());
+    }
+
+private:
+    Key epoch() const { return static_cast<Key>(state_.load() >> 32); }
+
+    std::atomic<uint64_t> state_{0};
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+// **************** CPU affinity / NUMA topology ***************
+
+// Topology comes from /sys/devices/system/node/node*/cpulist (no libnuma needed),
+// filtered by the CPUs this process may run on. Memory placement relies on Linux
+// first-touch: a page lands on the node of the thread that first writes it, so a
+// pinned worker that allocates and initialises its own structures gets node-local memory.
+// On other platforms everything is one node and pinning is a no-op.
+
+inline std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string range = list.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        if (!range.empty() && range != "\n") {
+            int lo = std::stoi(range.substr(0, dash));
+            int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+            for (int c = lo; c <= hi; c++) cpus.push_back(c);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+inline std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &set)) cpus.push_back(c);
+    }
+#endif
+    if (cpus.empty()) {
+        for (unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); c++)
+            cpus.push_back(static_cast<int>(c));
+    }
+    return cpus;
+}
+
+inline bool pinThisThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+struct NumaTopology {
+    std::vector<std::vector<int>> node_cpus;    // usable CPUs of every node that has any
+
+    static NumaTopology detect() {
+        std::vector<int> allowed = allowedCpus();
+        NumaTopology topology;
+        for (int node = 0;; node++) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!file) break;
+            std::string list;
+            std::getline(file, list);
+
+            std::vector<int> cpus;
+            for (int c : parseCpuList(list))
+                if (std::find(allowed.begin(), allowed.end(), c) != allowed.end()) cpus.push_back(c);
+            if (!cpus.empty()) topology.node_cpus.push_back(std::move(cpus));
+        }
+        if (topology.node_cpus.empty())
+            topology.node_cpus.push_back(allowed);
+        return topology;
+    }
+};
+
+// min_threads == max_threads → fixed pool (the default). Otherwise the pool is elastic:
+//  - grows (up to max_threads) when a task is queued, no worker is idle and either the
+//    queue is grow_queue_depth deep or it has been non-empty for grow_wait_time
+//  - a worker above min_threads that has been idle for idle_timeout retires
+// cpus non-empty → worker k is pinned to cpus[k % cpus.size()].
+// idle → spin/yield/park behaviour of a worker that finds the queue empty.
+// max_queue non-zero → at most that many queued tasks; overflow says what enqueue does
+// when the queue is full (see OverflowPolicy).
+
+// Block:      wait for a worker to make room. Don't use it from inside the pool's own
+//             tasks: with every worker blocked on a full queue nothing makes room.
+// CallerRuns: run the task on the submitting thread, which also slows the submitter down
+// Reject:     don't run it, enqueue returns EnqueueStatus::Rejected
+// DropOldest: queue it, throw away the oldest task of the least urgent lane instead
+//             (never a continuation; with only continuations queued nothing is dropped)
+enum class OverflowPolicy { Block, CallerRuns, Reject, DropOldest };
+
+// Rejected / Stopped: the task was destroyed without running (a future from the
+// enqueue(F, Args...) overload then reports std::future_errc::broken_promise).
+enum class EnqueueStatus { Queued, RanInCaller, Rejected, Stopped };
+
+// One count per submitted task, by what happened to it. guarded by queue_mutex_
+struct OverflowCounts {
+    uint64_t queued = 0;
+    uint64_t blocked = 0;               // queued too, after waiting for room
+    uint64_t ran_in_caller = 0;
+    uint64_t rejected = 0;
+    uint64_t dropped_oldest = 0;        // tasks thrown away to make room (queued counts the newcomer)
+    uint64_t after_stop = 0;
+};
+
+struct ThreadPoolOptions {
+    size_t min_threads = 1;
+    size_t max_threads = 1;
+    size_t starvation_limit = 32;
+    size_t grow_queue_depth = 64;
+    std::chrono::microseconds grow_wait_time{500};
+    std::chrono::milliseconds idle_timeout{2000};
+    std::vector<int> cpus;
+    IdlePolicy idle;
+    size_t max_queue = 0;               // 0: unbounded
+    OverflowPolicy overflow = OverflowPolicy::Block;
+};
+
+class ThreadPool{
+public:
+    explicit ThreadPool(int num_threads, size_t starvation_limit = 32)
+        : ThreadPool(fixedSize(num_threads, starvation_limit)){}
+
+    explicit ThreadPool(const ThreadPoolOptions& options)
+        : options_(options), tasks_queue_(options.starvation_limit){
+        options_.max_threads = std::max(options_.min_threads, options_.max_threads);
+
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        for(size_t i = 0; i < options_.min_threads; i++)
+            addThread(false);
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Fire and forget
+    EnqueueStatus enqueue(Task task, Priority priority = Priority::Normal){
+        return enqueue(std::move(task), nullptr, priority);
+    }
+
+    // label names the task in TaskTracer output (must outlive the dump)
+    EnqueueStatus enqueue(Task task, const char* label, Priority priority = Priority::Normal){
+        return pushOne(task, label, true, [&](TaskStamp stamp){ tasks_queue_.push(std::move(task), priority, stamp); });
+    }
+
+    // Earliest deadline first, ahead of every priority lane
+    EnqueueStatus enqueue(Task task, std::chrono::steady_clock::time_point deadline){
+        return pushOne(task, nullptr, true, [&](TaskStamp stamp){ tasks_queue_.push(std::move(task), deadline, stamp); });
+    }
+
+    // Whole batch under one lock, and only as many wakeups as there are
+    // idle workers to take the work (busy ones come back for more anyway).
+    // Returns how many will run (queued or ran in the caller); on Reject / after stop()
+    // the rest are left in the range.
+    template<typename Range>
+    size_t enqueue_bulk(Range&& tasks, Priority priority = Priority::Normal){
+        auto it = std::begin(tasks);
+        return pushMany(std::ranges::distance(tasks), [&]{ return Task(std::move(*it++)); }, priority, true);
+    }
+
+    // count tasks, task i runs fn(i). fn is copied into every task.
+    template<typename F>
+    size_t enqueue_n(size_t count, const F& fn, Priority priority = Priority::Normal){
+        size_t i = 0;
+        return pushMany(count, [&]{ return Task([fn, n = i++]() mutable { fn(n); }); }, priority, true);
+    }
+
+    // Work that was already admitted and must not be blocked or rejected: a strand's
+    // next batch, a resumed coroutine, a TaskGraph successor. Skips max_queue, and its
+    // lane is never evicted by OverflowPolicy::DropOldest.
+    // Never Stopped: after stop() it is queued while workers are still draining,
+    // otherwise it runs in the caller (RanInCaller).
+    EnqueueStatus enqueue_continuation(Task task){
+        return pushOne(task, nullptr, false, [&](TaskStamp stamp){ tasks_queue_.pushContinuation(std::move(task), stamp); });
+    }
+
+    template<typename Range>
+    size_t enqueue_continuation(Range&& tasks){
+        auto it = std::begin(tasks);
+        return pushMany(std::ranges::distance(tasks), [&]{ return Task(std::move(*it++)); }, Priority::Normal, false);
+    }
+
+    template<typename F, typename... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
+        auto [task, res] = packageTask(std::forward<F>(f), std::forward<Args>(args)...);
+        enqueue(std::move(task));
+        return std::move(res);
+    }
+
+    void stop(){
+        std::list<std::thread> to_join;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            stop_ = true;
+            // After this no worker touches the lists again (retiring needs !stop_)
+            to_join.splice(to_join.end(), threads_);
+            to_join.splice(to_join.end(), retired_);
+        }
+
+        idle_event_.notifyAll();
+        space_cv_.notify_all();             // blocked submitters get EnqueueStatus::Stopped
+
+        for(auto &t : to_join){
+            if(t.joinable())
+                t.join();
+        }
+    }
+
+    ScheduleAwaiter<ThreadPool> schedule(){
+        return {*this};
+    }
+
+    // Serial executor for key, see StrandMap. The map is created on first use.
+    template<typename Key>
+    Strand<ThreadPool> strand(const Key& key){
+        std::call_once(strands_once_, [this]{ strands_ = std::make_unique<StrandMap<ThreadPool>>(*this); });
+        return {*strands_, static_cast<uint64_t>(std::hash<Key>{}(key))};
+    }
+
+    // stop() has been called; workers may still be running what was queued
+    bool stopping() const {
+        return stop_.load();
+    }
+
+    // Live workers right now (changes over time for an elastic pool)
+    size_t size() const {
+        return live_threads_.load(std::memory_order_relaxed);
+    }
+
+    size_t queue_size() const {
+        return queued_.load(std::memory_order_relaxed);
+    }
+
+    OverflowCounts overflow_counts(){
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        return overflow_counts_;
+    }
+
+    // Aggregated on demand; counters keep running while this reads them
+    ThreadPoolMetrics metrics(){
+        ThreadPoolMetrics m;
+        m.threads = size();
+        m.queue_depth = queued_.load();
+#if THREAD_POOL_METRICS
+        double ns = nsPerMetricTick();
+        auto ms = [ns](uint64_t ticks){ return ticks * ns / 1e6; };
+
+        m.enabled = true;
+        m.tasks_submitted = submit_metrics_.submitted.load(std::memory_order_relaxed);
+        m.queue_high_water = submit_metrics_.high_water.load(std::memory_order_relaxed);
+        uint64_t wait_ticks = submit_metrics_.lock_wait_ticks.load(std::memory_order_relaxed);
+        m.lock_waits = submit_metrics_.lock_waits.load(std::memory_order_relaxed);
+        m.queue_wait.ns_per_tick = m.run_time.ns_per_tick = ns;
+
+        std::lock_guard<std::mutex> lock(queue_mutex_);     // worker_metrics_ may be growing
+        for(auto &w : worker_metrics_){
+            ThreadPoolMetrics::Histogram run_time;
+            run_time.ns_per_tick = ns;
+            w.run_time.addTo(run_time);
+
+            ThreadPoolMetrics::Worker worker;
+            worker.tasks_run = w.tasks_run.load(std::memory_order_relaxed);
+            worker.busy_ms = worker.tasks_run * run_time.mean_ns() / 1e6;
+            uint64_t waited = w.lock_wait_ticks.load(std::memory_order_relaxed);
+            worker.lock_wait_ms = ms(waited);
+            m.workers.push_back(worker);
+
+            m.tasks_run += worker.tasks_run;
+            m.lock_waits += w.lock_waits.load(std::memory_order_relaxed);
+            wait_ticks += waited;
+            w.queue_wait.addTo(m.queue_wait);
+            m.run_time += run_time;
+        }
+        m.lock_wait_ms = ms(wait_ticks);
+#endif
+        return m;
+    }
+
+    ~ThreadPool(){
+        stop();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using ThreadIt = std::list<std::thread>::iterator;
+
+    static ThreadPoolOptions fixedSize(int num_threads, size_t starvation_limit){
+        ThreadPoolOptions options;
+        options.min_threads = options.max_threads = num_threads;
+        options.starvation_limit = starvation_limit;
+        return options;
+    }
+
+    // Caller holds queue_mutex_. The new worker blocks on that same mutex first,
+    // so `self` is valid before it can ever use it.
+    // growing → counted in starting_threads_ until it runs, so a burst of
+    // enqueues does not spawn again for work this thread is about to take
+    void addThread(bool growing){
+        size_t index = spawned_threads_++;
+        int cpu = options_.cpus.empty() ? -1 : options_.cpus[index % options_.cpus.size()];
+        auto self = threads_.emplace(threads_.end());
+#if THREAD_POOL_METRICS
+        WorkerMetrics* metrics;
+        if(free_worker_metrics_.empty()){
+            metrics = &worker_metrics_.emplace_back();
+        }else{
+            metrics = free_worker_metrics_.back();
+            free_worker_metrics_.pop_back();
+        }
+#else
+        static WorkerMetrics unused;
+        WorkerMetrics* metrics = &unused;
+#endif
+        *self = std::thread([this, self, cpu, growing, metrics, index]{
+            if(cpu >= 0)
+                pinThisThread(cpu);
+            TaskTracer::nameThread("pool worker " + std::to_string(index));
+            worker(self, growing, *metrics);
+        });
+        live_threads_.fetch_add(1, std::memory_order_relaxed);
+        if(growing)
+            starting_threads_++;
+    }
+
+    void worker(ThreadIt self, bool growing, WorkerMetrics& metrics){
+        bool elastic = options_.min_threads < options_.max_threads;
+        std::unique_lock<std::mutex> lock(queue_mutex_, std::defer_lock);
+        metrics.lock(lock);
+        if(growing)
+            starting_threads_--;
+
+        while(true){
+            if(!tasks_queue_.empty()){
+                TaskStamp queued_at;
+                Task task = tasks_queue_.pop(queued_at);
+                queued_.store(tasks_queue_.size());
+                if(tasks_queue_.empty())
+                    backlog_since_ = Clock::time_point{};
+                bool made_room = waiting_for_room_ > 0;
+                running_++;
+
+                lock.unlock();
+                if(made_room)
+                    space_cv_.notify_one();
+                TaskStamp started = metrics.taskStarted(queued_at);
+                TaskTracer::begin(queued_at);
+                task();
+                TaskTracer::end(queued_at);
+                metrics.taskFinished(started);
+                task = Task{};          // captures die outside the lock
+                metrics.lock(lock);
+                running_--;
+                continue;
+            }
+
+            if(stop_)
+                return;
+
+            idle_workers_++;
+            lock.unlock();
+            bool woke = idleWait(elastic);
+            metrics.lock(lock);
+            idle_workers_--;
+
+            if(!woke && tasks_queue_.empty() && !stop_ &&
+               live_threads_.load(std::memory_order_relaxed) > options_.min_threads){
+                // Idle too long: hand our std::thread to retired_, the next
+                // addThread()/stop() joins it once we have returned
+                live_threads_.fetch_sub(1, std::memory_order_relaxed);
+                retired_.splice(retired_.end(), threads_, self);
+#if THREAD_POOL_METRICS
+                // Not touched again: the next worker takes the slot after we unlock
+                free_worker_metrics_.push_back(&metrics);
+#endif
+                return;
+            }
+        }
+    }
+
+    // Spin → yield → park on idle_event_, without holding queue_mutex_.
+    // Returns false only if an elastic worker parked for idle_timeout with nothing to do.
+    bool idleWait(bool elastic){
+        auto ready = [this]{ return queued_.load() > 0 || stop_.load(); };
+
+        for(unsigned i = 0; i < options_.idle.spin_iterations; i++){
+            if(ready())
+                return true;
+            cpuRelax();
+        }
+        for(unsigned i = 0; i < options_.idle.yield_iterations; i++){
+            if(ready())
+                return true;
+            std::this_thread::yield();
+        }
+
+        auto key = idle_event_.prepareWait();
+        if(ready()){
+            idle_event_.cancelWait();
+            return true;
+        }
+        if(elastic)
+            return idle_event_.wait_for(key, options_.idle_timeout);
+        idle_event_.wait(key);
+        return true;
+    }
+
+    // Caller holds queue_mutex_ and has just queued work that `wanted` more workers could take.
+    void maybeGrow(size_t wanted){
+        if(wanted == 0 || starting_threads_ > 0)
+            return;
+        size_t live = live_threads_.load(std::memory_order_relaxed);
+        if(live >= options_.max_threads)
+            return;
+
+        if(tasks_queue_.size() < options_.grow_queue_depth){
+            // Not deep enough: grow only if the backlog has been sitting there too long
+            auto now = Clock::now();
+            if(backlog_since_ == Clock::time_point{}){
+                backlog_since_ = now;
+                return;
+            }
+            if(now - backlog_since_ < options_.grow_wait_time)
+                return;
+            backlog_since_ = now;
+            wanted = 1;
+        }
+
+        reapRetired();
+        for(size_t i = 0; i < std::min(wanted, options_.max_threads - live); i++)
+            addThread(true);
+    }
+
+    // Caller holds queue_mutex_. A retired worker splices itself out just before
+    // returning, so this join is at most a short wait.
+    void reapRetired(){
+        for(auto &t : retired_)
+            t.join();
+        retired_.clear();
+    }
+
+    TaskStamp stampTask(const char* label){
+        TaskStamp stamp = submit_metrics_.stamp();
+        TaskTracer::enqueued(stamp, label);
+        return stamp;
+    }
+
+    // Caller holds queue_mutex_. After stop(): some worker is still going to look at
+    // tasks_queue_ again, so a continuation queued now runs before the last one exits.
+    bool draining() const {
+        return running_ > 0 || !tasks_queue_.empty();
+    }
+
+    // Caller holds queue_mutex_
+    bool full() const {
+        return options_.max_queue != 0 && tasks_queue_.size() >= options_.max_queue;
+    }
+
+    // Caller holds queue_mutex_ (through lock). Whatever this submitter queued so far is
+    // published first: the workers it is waiting for may be parked.
+    void waitForRoom(std::unique_lock<std::mutex>& lock){
+        queued_.store(tasks_queue_.size());
+        idle_event_.notifyAll();
+        waiting_for_room_++;
+        space_cv_.wait(lock, [this]{ return stop_ || !full(); });
+        waiting_for_room_--;
+    }
+
+    // task: what push() queues, run here instead under CallerRuns.
+    // bounded == false: continuation, max_queue does not apply.
+    template<typename Push>
+    EnqueueStatus pushOne(Task& task, const char* label, bool bounded, Push push){
+        size_t idle;
+        Task dropped;                   // destroyed outside the lock
+        TaskStamp stamp = stampTask(label);
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_, std::defer_lock);
+            submit_metrics_.lock(lock);
+            if(bounded && !stop_ && full()){
+                switch(options_.overflow){
+                case OverflowPolicy::Block:
+                    overflow_counts_.blocked++;
+                    waitForRoom(lock);
+                    break;
+                case OverflowPolicy::CallerRuns:
+                    overflow_counts_.ran_in_caller++;
+                    lock.unlock();
+                    task();
+                    return EnqueueStatus::RanInCaller;
+                case OverflowPolicy::Reject:
+                    overflow_counts_.rejected++;
+                    return EnqueueStatus::Rejected;
+                case OverflowPolicy::DropOldest:
+                    dropped = tasks_queue_.dropOldest();
+                    if(dropped)
+                        overflow_counts_.dropped_oldest++;
+                    break;
+                }
+            }
+            if(stop_ && bounded){
+                overflow_counts_.after_stop++;
+                return EnqueueStatus::Stopped;
+            }
+            if(stop_ && !draining()){
+                overflow_counts_.ran_in_caller++;
+                lock.unlock();
+                task();
+                return EnqueueStatus::RanInCaller;
+            }
+            push(stamp);
+            overflow_counts_.queued++;
+            submit_metrics_.pushed(1, tasks_queue_.size());
+            queued_.store(tasks_queue_.size());
+            idle = idle_workers_.load();
+            if(idle == 0 && !stop_ && options_.min_threads < options_.max_threads)
+                maybeGrow(1);
+        }
+        if(idle > 0)
+            idle_event_.notify();       // no syscall unless someone is actually parked
+        return EnqueueStatus::Queued;
+    }
+
+    // next() makes the next of count tasks. Returns how many will run.
+    // bounded == false: continuations, their own lane (priority unused).
+    template<typename Next>
+    size_t pushMany(size_t count, Next next, Priority priority, bool bounded){
+        size_t pushed = 0, in_caller = 0, idle;
+        std::vector<Task> dropped;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_, std::defer_lock);
+            submit_metrics_.lock(lock);
+            auto admitted = [&]{ return !stop_ || (!bounded && draining()); };
+            for(; pushed < count && admitted(); pushed++){
+                if(bounded && full()){
+                    OverflowPolicy policy = options_.overflow;
+                    if(policy == OverflowPolicy::Block){
+                        overflow_counts_.blocked++;
+                        waitForRoom(lock);
+                        if(stop_)
+                            break;
+                    }else if(policy == OverflowPolicy::CallerRuns){
+                        in_caller = count - pushed;
+                        overflow_counts_.ran_in_caller += in_caller;
+                        break;
+                    }else if(policy == OverflowPolicy::Reject){
+                        overflow_counts_.rejected += count - pushed;
+                        break;
+                    }else if(Task oldest = tasks_queue_.dropOldest()){
+                        overflow_counts_.dropped_oldest++;
+                        dropped.push_back(std::move(oldest));
+                    }
+                }
+                if(bounded)
+                    tasks_queue_.push(next(), priority, stampTask(nullptr));
+                else
+                    tasks_queue_.pushContinuation(next(), stampTask(nullptr));
+            }
+            if(stop_ && pushed < count && bounded)
+                overflow_counts_.after_stop += count - pushed;
+            else if(stop_ && pushed < count){
+                in_caller = count - pushed;     // stopped and drained: continuations run here
+                overflow_counts_.ran_in_caller += in_caller;
+            }
+            overflow_counts_.queued += pushed;
+            submit_metrics_.pushed(pushed, tasks_queue_.size());
+            queued_.store(tasks_queue_.size());
+            idle = idle_workers_.load();
+            if(!stop_)
+                maybeGrow(pushed - std::min(pushed, idle));
+        }
+        idle_event_.notify(std::min(pushed, idle));     // no syscall unless someone is actually parked
+        dropped.clear();
+
+        // CallerRuns (or continuations after stop()): the rest runs here, in order,
+        // after the queued part is visible
+        for(size_t i = 0; i < in_caller; i++){
+            Task task = next();
+            task();
+        }
+        return pushed + in_caller;
+    }
+
+    ThreadPoolOptions options_;
+    std::list<std::thread> threads_;    // guarded by queue_mutex_
+    std::list<std::thread> retired_;    // exited (or exiting) workers not joined yet
+    std::atomic<size_t> live_threads_{0};
+    size_t starting_threads_ = 0;
+    size_t spawned_threads_ = 0;
+    Clock::time_point backlog_since_{};
+
+    TaskLanes tasks_queue_;
+    std::mutex queue_mutex_;
+    EventCount idle_event_;
+    std::atomic<size_t> queued_{0};         // tasks_queue_.size(), readable without the lock
+    std::atomic<size_t> idle_workers_{0};   // spinning, yielding or parked
+    std::atomic<bool> stop_{false};
+    size_t running_ = 0;                    // workers inside a task, guarded by queue_mutex_
+
+    std::condition_variable space_cv_;      // submitters blocked on a full queue (OverflowPolicy::Block)
+    size_t waiting_for_room_ = 0;           // guarded by queue_mutex_
+    OverflowCounts overflow_counts_;
+
+    std::once_flag strands_once_;
+    std::unique_ptr<StrandMap<ThreadPool>> strands_;
+
+    SubmitMetrics submit_metrics_;
+#if THREAD_POOL_METRICS
+    std::deque<WorkerMetrics> worker_metrics_;  // guarded by queue_mutex_, never shrinks (stable addresses)
+    std::vector<WorkerMetrics*> free_worker_metrics_;  // slots of retired workers, reused by addThread()
+                                                       // so the deque stops at the peak worker count
+#endif
+};
+
+// **************** Work Stealing ThreadPool ***************
+
+// With one tasks_queue_ + one queue_mutex_ every worker fights for the same lock,
+// which becomes the whole bottleneck once tasks are only a few microseconds long.
+// Here each worker owns a local deque:
+//  - a task submitted from inside a worker goes onto that worker's own deque
+//  - the owner pops the newest task (LIFO → hot in cache)
+//  - tasks from outside the pool go to an injection queue
+//  - an idle worker first checks the injection queue, then steals from the back
+//    (oldest end) of the other workers' deques
+// Same enqueue()/stop() API as ThreadPool above.
+//
+// NUMA: built from a NumaTopology, workers are grouped per node, one pinned worker per CPU.
+// Every node has its own injection queue, wakeup and pending count, and each worker
+// allocates its deque itself after pinning (first-touch → node-local). Search order:
+// own deque → own node's queue → same-node peers → (fallback) other nodes.
+
+class WorkStealingQueue {
+    RingQueue<Task> deque_;
+    mutable std::mutex mtx_;
+
+public:
+    void push(Task task) {
+        std::lock_guard lock(mtx_);
+        deque_.push(std::move(task));
+    }
+
+    // Owner end: newest task
+    bool try_pop(Task& task) {
+        std::lock_guard lock(mtx_);
+        if (deque_.empty()) return false;
+        task = std::move(deque_.back());
+        deque_.pop_back();
+        return true;
+    }
+
+    // Thief end: oldest task
+    bool try_steal(Task& task) {
+        std::lock_guard lock(mtx_);
+        if (deque_.empty()) return false;
+        task = std::move(deque_.front());
+        deque_.pop();
+        return true;
+    }
+};
+
+class WorkStealingThreadPool {
+public:
+    explicit WorkStealingThreadPool(int num_threads) {
+        start(std::vector<size_t>(num_threads, 0), std::vector<int>(num_threads, -1), 1);
+    }
+
+    // One worker pinned on every CPU of every node. cross_node_steal == false keeps
+    // every worker on its own node's work (used to measure local vs remote).
+    explicit WorkStealingThreadPool(const NumaTopology& topology, bool cross_node_steal = true)
+        : cross_node_steal_(cross_node_steal) {
+        std::vector<size_t> worker_node;
+        std::vector<int> worker_cpu;
+        for (size_t n = 0; n < topology.node_cpus.size(); n++) {
+            for (int cpu : topology.node_cpus[n]) {
+                worker_node.push_back(n);
+                worker_cpu.push_back(cpu);
+            }
+        }
+        start(worker_node, worker_cpu, topology.node_cpus.size());
+    }
+
+    WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+    WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+    // From a worker → its own deque. From outside → node queues, round robin.
+    // After stop() nothing is dropped (a child task or a co_await schedule() may still
+    // come in while the pool drains): a worker's own deque is always drained before it
+    // exits, and a task from outside runs right here in the caller.
+    void enqueue(Task task) {
+        if (tl_pool_ == this) {
+            local_queues_[tl_index_]->queue.push(std::move(task));
+            announce(worker_node_[tl_index_]);
+        } else {
+            enqueue(std::move(task), next_node_.fetch_add(1, std::memory_order_relaxed) % nodes_.size());
+        }
+    }
+
+    void enqueue(Task task, size_t node) {
+        if (stop_) {
+            if (tl_pool_ == this)
+                enqueue(std::move(task));
+            else
+                task();
+            return;
+        }
+
+        {
+            std::lock_guard lock(nodes_[node].mtx);
+            nodes_[node].queue.push(std::move(task));
+        }
+        announce(node);
+    }
+
+    template <typename F, typename... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
+        auto [task, res] = packageTask(std::forward<F>(f), std::forward<Args>(args)...);
+        enqueue(std::move(task));
+        return std::move(res);
+    }
+
+    ScheduleAwaiter<WorkStealingThreadPool> schedule() {
+        return {*this};
+    }
+
+    size_t nodes() const { return nodes_.size(); }
+
+    void stop() {
+        stop_ = true;
+        for (auto& node : nodes_) {
+            std::lock_guard lock(node.sleep_mutex);
+            node.sleep_cv.notify_all();
+        }
+
+        for (auto& t : threads_) {
+            if (t.joinable())
+                t.join();
+        }
+
+        // A submitter that saw !stop_ just before may have queued after the last worker
+        // checked pending_: run those stragglers here
+        for (auto& node : nodes_) {
+            for (Task task; popQueue(node, task);) {
+                node.pending.fetch_sub(1);
+                pending_.fetch_sub(1);
+                task();
+            }
+        }
+    }
+
+    ~WorkStealingThreadPool() {
+        stop();
+    }
+
+private:
+    struct alignas(64) LocalQueue {     // one cache line per owner, no false sharing
+        WorkStealingQueue queue;
+    };
+
+    struct alignas(64) NodeGroup {
+        std::mutex mtx;
+        RingQueue<Task> queue;              // submissions from outside aimed at this node
+        std::vector<size_t> workers;
+
+        std::atomic<size_t> pending{0};     // tasks on this node not yet picked up
+        std::atomic<int> sleepers{0};
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_cv;
+    };
+
+    void start(const std::vector<size_t>& worker_node, const std::vector<int>& worker_cpu, size_t node_count) {
+        size_t n = worker_node.size();
+        nodes_ = std::vector<NodeGroup>(node_count);
+        worker_node_ = worker_node;
+        local_queues_.resize(n);
+        for (size_t i = 0; i < n; i++)
+            nodes_[worker_node[i]].workers.push_back(i);
+
+        // Nobody may steal before every worker has allocated its deque
+        started_ = std::make_unique<std::latch>(n + 1);
+        for (size_t i = 0; i < n; i++) {
+            threads_.emplace_back([this, i, cpu = worker_cpu[i]] {
+                if (cpu >= 0)
+                    pinThisThread(cpu);
+                local_queues_[i] = std::make_unique<LocalQueue>();
+                started_->arrive_and_wait();
+                worker(i);
+            });
+        }
+        started_->arrive_and_wait();
+    }
+
+    // pending must be bumped before looking at sleepers, and a worker bumps sleepers
+    // before re-checking pending → one of the two always sees the other.
+    void announce(size_t node) {
+        nodes_[node].pending.fetch_add(1);
+        pending_.fetch_add(1);
+
+        if (wakeOne(nodes_[node]) || !cross_node_steal_)
+            return;
+        for (size_t k = 1; k < nodes_.size(); k++) {
+            if (wakeOne(nodes_[(node + k) % nodes_.size()]))
+                return;
+        }
+    }
+
+    static bool wakeOne(NodeGroup& node) {
+        if (node.sleepers.load() == 0) return false;
+        std::lock_guard lock(node.sleep_mutex);
+        node.sleep_cv.notify_one();
+        return true;
+    }
+
+    static bool popQueue(NodeGroup& node, Task& task) {
+        std::lock_guard lock(node.mtx);
+        if (node.queue.empty()) return false;
+        task = std::move(node.queue.front());
+        node.queue.pop();
+        return true;
+    }
+
+    bool stealFromNode(size_t node, size_t self, Task& task) {
+        const auto& workers = nodes_[node].workers;
+        size_t start = self % workers.size();
+        for (size_t k = 0; k < workers.size(); k++) {
+            size_t victim = workers[(start + k) % workers.size()];
+            if (victim != self && local_queues_[victim]->queue.try_steal(task))
+                return true;
+        }
+        return false;
+    }
+
+    // from = node whose pending count the task was charged to
+    bool try_get_task(size_t index, Task& task, size_t& from) {
+        from = worker_node_[index];
+        if (local_queues_[index]->queue.try_pop(task) || popQueue(nodes_[from], task) ||
+            stealFromNode(from, index, task))
+            return true;
+
+        if (!cross_node_steal_)
+            return false;
+        for (size_t k = 1; k < nodes_.size(); k++) {
+            from = (worker_node_[index] + k) % nodes_.size();
+            if (popQueue(nodes_[from], task) || stealFromNode(from, index, task))
+                return true;
+        }
+        return false;
+    }
+
+    void worker(size_t index) {
+        tl_pool_ = this;
+        tl_index_ = index;
+        NodeGroup& home = nodes_[worker_node_[index]];
+        auto visible = [&] { return cross_node_steal_ ? pending_.load() : home.pending.load(); };
+
+        while (true) {
+            Task task;
+            size_t from;
+            if (try_get_task(index, task, from)) {
+                nodes_[from].pending.fetch_sub(1);
+                pending_.fetch_sub(1);
+                task();
+                continue;
+            }
+
+            std::unique_lock lock(home.sleep_mutex);
+            home.sleepers.fetch_add(1);
+            home.sleep_cv.wait(lock, [&] {
+                return visible() > 0 || stop_;
+            });
+            home.sleepers.fetch_sub(1);
+
+            if (stop_ && visible() == 0)
+                return;
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::vector<std::unique_ptr<LocalQueue>> local_queues_;
+    std::vector<size_t> worker_node_;
+    std::vector<NodeGroup> nodes_;
+    std::unique_ptr<std::latch> started_;
+    bool cross_node_steal_ = true;
+
+    std::atomic<size_t> next_node_{0};
+    std::atomic<size_t> pending_{0};    // all nodes
+    std::atomic<bool> stop_{false};
+
+    static inline thread_local WorkStealingThreadPool* tl_pool_ = nullptr;
+    static inline thread_local size_t tl_index_ = 0;
+};
+
+
+// **************** Benchmark ***************
+
+// Tiny tasks (~1µs of spinning). Two shapes:
+//  flat   → main thread submits every task (all traffic goes through the shared queue)
+//  fanout → every task spawns two children from inside the pool (binary tree)
+
+inline void tinyWork() {
+    volatile int x = 0;
+    for (int i = 0; i < 200; i++) x = x + i;
+}
+
+template <typename Pool>
+void spawnTree(Pool& pool, std::atomic<long>& done, int depth) {
+    tinyWork();
+    if (depth > 0) {
+        pool.enqueue(Task([&pool, &done, depth] { spawnTree(pool, done, depth - 1); }));
+        pool.enqueue(Task([&pool, &done, depth] { spawnTree(pool, done, depth - 1); }));
+    }
+    done.fetch_add(1, std::memory_order_release);
+}
+
+inline void waitFor(const std::atomic<long>& done, long expected) {
+    while (done.load(std::memory_order_acquire) < expected)
+        std::this_thread::yield();
+}
+
+// Returns ns per task.
+template <typename Pool>
+double benchFlat(int num_threads, long num_tasks) {
+    Pool pool(num_threads);
+    std::atomic<long> done{0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < num_tasks; i++) {
+        pool.enqueue(Task([&done] {
+            tinyWork();
+            done.fetch_add(1, std::memory_order_release);
+        }));
+    }
+    waitFor(done, num_tasks);
+    auto end = std::chrono::steady_clock::now();
+
+    pool.stop();
+    return std::chrono::duration<double, std::nano>(end - start).count() / num_tasks;
+}
+
+template <typename Pool>
+double benchFanOut(int num_threads, int depth) {
+    Pool pool(num_threads);
+    std::atomic<long> done{0};
+    long num_tasks = (2L << depth) - 1;
+
+    auto start = std::chrono::steady_clock::now();
+    pool.enqueue(Task([&pool, &done, depth] { spawnTree(pool, done, depth); }));
+    waitFor(done, num_tasks);
+    auto end = std::chrono::steady_clock::now();
+
+    pool.stop();
+    return std::chrono::duration<double, std::nano>(end - start).count() / num_tasks;
+}
+
+void benchWorkStealing(int max_threads) {
+    constexpr long kFlatTasks = 200000;
+    constexpr int kTreeDepth = 17;          // 262143 tasks
+
+    std::cout << "threads | flat: single-queue  work-stealing | fanout: single-queue  work-stealing  (ns/task)\n";
+    for (int n = 1; n <= max_threads; n *= 2) {
+        std::cout << std::setw(7) << n << " | "
+                  << std::setw(18) << benchFlat<ThreadPool>(n, kFlatTasks)
+                  << std::setw(15) << benchFlat<WorkStealingThreadPool>(n, kFlatTasks) << " | "
+                  << std::setw(20) << benchFanOut<ThreadPool>(n, kTreeDepth)
+                  << std::setw(15) << benchFanOut<WorkStealingThreadPool>(n, kTreeDepth) << '\n';
+    }
+}
+
+// Task/future cost: allocations and ns per task, before (std::function, make_shared<packaged_task>)
+// and after (inline Task, pooled promise state). Counted by the operator new below.
+
+std::atomic<long> g_allocations{0};
+std::atomic<long> g_allocation_bytes{0};
+
+void* operator new(size_t n) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocation_bytes.fetch_add(n, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+struct Payload {                // 40 bytes of capture: too big for std::function's small buffer
+    long a, b, c, d, e;
+};
+
+template <typename Submit>
+void reportTaskCost(const char* name, long num_tasks, Submit submit) {
+    constexpr long kBatch = 1000;   // bounded in-flight work, like a real caller
+
+    for (long i = 0; i < kBatch; i++) submit(i);    // warm queue + free lists
+
+    long allocs_before = g_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < num_tasks; i += kBatch)
+        submit(-kBatch);                             // negative → submit a batch and wait
+    auto end = std::chrono::steady_clock::now();
+    long allocs = g_allocations.load() - allocs_before;
+
+    std::cout << std::setw(34) << std::left << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(2) << double(allocs) / num_tasks
+              << std::setw(12) << std::chrono::duration<double, std::nano>(end - start).count() / num_tasks
+              << '\n';
+}
+
+void benchTask(int num_threads) {
+    constexpr long kTasks = 200000;
+    ThreadPool pool(num_threads);
+    std::atomic<long> done{0};
+    Payload payload{1, 2, 3, 4, 5};
+
+    // Submits a batch of |n| fire-and-forget tasks and waits for all of them.
+    auto fireAndForget = [&](auto makeTask) {
+        return [&, makeTask](long n) {
+            long batch = n < 0 ? -n : 1;
+            long target = done.load() + batch;
+            for (long i = 0; i < batch; i++) pool.enqueue(makeTask());
+            waitFor(done, target);
+        };
+    };
+
+    std::cout << "case                              allocs/task     ns/task\n";
+
+    reportTaskCost("before: std::function", kTasks, fireAndForget([&] {
+        return Task(std::function<void()>([&done, payload] {
+            if (payload.a) done.fetch_add(1, std::memory_order_release);
+        }));
+    }));
+
+    reportTaskCost("after:  Task (inline)", kTasks, fireAndForget([&] {
+        return Task([&done, payload] {
+            if (payload.a) done.fetch_add(1, std::memory_order_release);
+        });
+    }));
+
+    // The promise itself takes 24 of Task's 48 inline bytes, so keep this capture small
+    std::vector<std::future<long>> futures;
+    futures.reserve(1000);
+
+    auto withFutures = [&](auto submitOne) {
+        return [&, submitOne](long n) {
+            long batch = n < 0 ? -n : 1;
+            for (long i = 0; i < batch; i++) futures.push_back(submitOne(i));
+            for (auto& f : futures) f.get();
+            futures.clear();
+        };
+    };
+
+    reportTaskCost("before: make_shared<packaged_task>", kTasks, withFutures([&](long i) {
+        auto task = std::make_shared<std::packaged_task<long()>>([a = payload.a, i] { return a + i; });
+        std::future<long> res = task->get_future();
+        pool.enqueue(Task(std::function<void()>([task] { (*task)(); })));
+        return res;
+    }));
+
+    reportTaskCost("after:  enqueue() -> future", kTasks, withFutures([&](long i) {
+        return pool.enqueue([a = payload.a, i] { return a + i; });
+    }));
+
+    pool.stop();
+}
+
+// Submit cost per task when fanning out batches of tiny jobs:
+// enqueue() in a loop vs enqueue_n / enqueue_bulk (one lock + at most #idle wakeups per batch).
+
+void benchBulk(int num_threads) {
+    constexpr long kTasks = 640000;
+
+    std::cout << "batch   | enqueue() loop  enqueue_n  enqueue_bulk  (submit ns/task)\n";
+    for (long batch : {1L, 64L, 10000L}) {
+        long rounds = kTasks / batch;
+        std::cout << std::setw(7) << batch << " |";
+
+        for (int variant = 0; variant < 3; variant++) {
+            ThreadPool pool(num_threads);
+            std::atomic<long> done{0};
+            auto job = [&done](size_t) { done.fetch_add(1, std::memory_order_relaxed); };
+            std::vector<Task> tasks;
+            tasks.reserve(batch);
+            double submit_ns = 0;
+
+            for (long r = 0; r < rounds; r++) {
+                if (variant == 2) {
+                    for (long i = 0; i < batch; i++) tasks.emplace_back([job] { job(0); });
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                if (variant == 0) {
+                    for (long i = 0; i < batch; i++) pool.enqueue(Task([job, i] { job(i); }));
+                } else if (variant == 1) {
+                    pool.enqueue_n(batch, job);
+                } else {
+                    pool.enqueue_bulk(tasks);
+                }
+                submit_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+                tasks.clear();
+                waitFor(done, (r + 1) * batch);
+            }
+            pool.stop();
+            std::cout << std::setw(variant == 0 ? 15 : 12) << std::fixed << std::setprecision(1)
+                      << submit_ns / kTasks;
+        }
+        std::cout << '\n';
+    }
+}
+
+// **************** Parallel algorithms ***************
+
+// parallel_for / parallel_reduce / parallel_inclusive_scan / parallel_sort on an existing pool.
+// All of them are built on parallelChunks(): up to pool.size() helper tasks plus the calling
+// thread claim [begin, end) chunks from one atomic cursor (guided self-scheduling: a chunk is
+// remaining / (2 * participants), never below the grain). Early chunks are big so claiming is
+// cheap, the tail is split finely so nobody finishes long before the others. The caller runs
+// chunks too and only blocks for chunks that other workers are still in the middle of.
+
+struct ParallelLoopState {
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> completed{0};
+    size_t total = 0;
+    size_t grain = 1;
+    size_t participants = 1;
+
+    // Body lives on the caller's stack. Helpers only touch it while they hold an
+    // unfinished chunk, and the caller does not return before every chunk is done.
+    void* body = nullptr;
+    void (*call)(void*, size_t, size_t) = nullptr;
+
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    bool claim(size_t& begin, size_t& end) {
+        size_t cur = next.load(std::memory_order_relaxed);
+        while (cur < total) {
+            size_t remaining = total - cur;
+            size_t chunk = std::min(remaining, std::max(grain, remaining / (2 * participants)));
+            if (next.compare_exchange_weak(cur, cur + chunk, std::memory_order_relaxed)) {
+                begin = cur;
+                end = cur + chunk;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run() {
+        size_t begin, end;
+        while (claim(begin, end)) {
+            try {
+                call(body, begin, end);
+            } catch (...) {
+                if (!failed.exchange(true))
+                    error = std::current_exception();
+            }
+            if (completed.fetch_add(end - begin, std::memory_order_acq_rel) + (end - begin) == total)
+                completed.notify_all();
+        }
+    }
+};
+
+// Runs body(begin, end) over [0, n). grain == 0 → pick one from n and the pool size.
+template <typename Body>
+void parallelChunks(ThreadPool& pool, size_t n, size_t grain, Body&& body) {
+    if (n == 0) return;
+
+    size_t participants = pool.size() + 1;
+    if (grain == 0)
+        grain = std::clamp(n / (participants * 8), size_t(1), size_t(2048));
+
+    if (participants == 1 || n <= grain) {
+        body(size_t(0), n);
+        return;
+    }
+
+    // Heap state: a helper that only starts after everything is done must still find it
+    auto state = std::make_shared<ParallelLoopState>();
+    state->total = n;
+    state->grain = grain;
+    state->participants = participants;
+    state->body = &body;
+    state->call = [](void* b, size_t begin, size_t end) {
+        (*static_cast<std::remove_reference_t<Body>*>(b))(begin, end);
+    };
+
+    size_t helpers = std::min(pool.size(), (n + grain - 1) / grain - 1);
+    pool.enqueue_n(helpers, [state](size_t) { state->run(); });
+
+    state->run();
+
+    size_t done;
+    while ((done = state->completed.load(std::memory_order_acquire)) != n)
+        state->completed.wait(done, std::memory_order_acquire);
+
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+template <typename RandomIt, typename F>
+void parallel_for(ThreadPool& pool, RandomIt first, RandomIt last, F f, size_t grain = 0) {
+    parallelChunks(pool, last - first, grain, [&](size_t begin, size_t end) {
+        for (auto it = first + begin; it != first + end; ++it)
+            f(*it);
+    });
+}
+
+// op must be associative and commutative (same contract as std::reduce)
+template <typename RandomIt, typename T, typename BinaryOp = std::plus<>>
+T parallel_reduce(ThreadPool& pool, RandomIt first, RandomIt last, T init, BinaryOp op = {}, size_t grain = 0) {
+    std::mutex mtx;
+    parallelChunks(pool, last - first, grain, [&](size_t begin, size_t end) {
+        T local = first[begin];
+        for (auto it = first + begin + 1; it != first + end; ++it)
+            local = op(std::move(local), *it);
+
+        std::lock_guard lock(mtx);      // once per chunk, chunks are few
+        init = op(std::move(init), std::move(local));
+    });
+    return init;
+}
+
+// Reduce-then-scan: block sums in parallel, a short sequential scan over the block
+// sums, then every block is scanned in parallel starting from its offset.
+template <typename RandomIt, typename OutIt, typename BinaryOp = std::plus<>>
+OutIt parallel_inclusive_scan(ThreadPool& pool, RandomIt first, RandomIt last, OutIt d_first, BinaryOp op = {}) {
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    constexpr size_t kMinBlock = 4096;
+
+    size_t n = last - first;
+    size_t blocks = std::min((pool.size() + 1) * 4, n / kMinBlock);
+    if (blocks < 2)
+        return std::inclusive_scan(first, last, d_first, op);
+
+    auto blockBegin = [&](size_t b) { return b * n / blocks; };
+
+    std::vector<T> sums(blocks);
+    parallelChunks(pool, blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; b++) {
+            auto it = first + blockBegin(b), end = first + blockBegin(b + 1);
+            T acc = *it;
+            for (++it; it != end; ++it) acc = op(std::move(acc), *it);
+            sums[b] = std::move(acc);
+        }
+    });
+
+    for (size_t b = 1; b < blocks; b++)
+        sums[b] = op(sums[b - 1], sums[b]);
+
+    parallelChunks(pool, blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; b++) {
+            auto begin = first + blockBegin(b), end = first + blockBegin(b + 1);
+            if (b == 0)
+                std::inclusive_scan(begin, end, d_first, op);
+            else
+                std::inclusive_scan(begin, end, d_first + blockBegin(b), op, sums[b - 1]);
+        }
+    });
+    return d_first + n;
+}
+
+// Samplesort: splitters from a sorted random sample, every input block counts and then
+// scatters its elements into per-bucket ranges of a buffer, buckets are sorted in parallel
+// and moved back. Needs n elements of scratch space.
+template <typename RandomIt, typename Compare = std::less<>>
+void parallel_sort(ThreadPool& pool, RandomIt first, RandomIt last, Compare comp = {}) {
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    constexpr size_t kSequentialCutoff = 1 << 15;
+    constexpr size_t kOversample = 32;
+
+    size_t n = last - first;
+    size_t participants = pool.size() + 1;
+    if (participants == 1 || n < kSequentialCutoff) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    // More buckets/blocks than participants so claiming evens out skew
+    size_t buckets = participants * 4;
+    size_t blocks = participants * 4;
+
+    std::vector<T> sample;
+    sample.reserve(buckets * kOversample);
+    std::minstd_rand rng(static_cast<unsigned>(n));
+    for (size_t i = 0; i < buckets * kOversample; i++)
+        sample.push_back(first[rng() % n]);
+    std::sort(sample.begin(), sample.end(), comp);
+
+    std::vector<T> splitters;
+    splitters.reserve(buckets - 1);
+    for (size_t k = 1; k < buckets; k++)
+        splitters.push_back(sample[k * kOversample]);
+
+    auto bucketOf = [&](const T& x) {
+        return std::upper_bound(splitters.begin(), splitters.end(), x, comp) - splitters.begin();
+    };
+    auto blockBegin = [&](size_t b) { return b * n / blocks; };
+
+    // counts[block * buckets + bucket]
+    std::vector<size_t> counts(blocks * buckets, 0);
+    parallelChunks(pool, blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; b++) {
+            size_t* c = &counts[b * buckets];
+            for (size_t i = blockBegin(b); i < blockBegin(b + 1); i++)
+                c[bucketOf(first[i])]++;
+        }
+    });
+
+    // Bucket-major layout: turn counts into each block's write offset per bucket
+    std::vector<size_t> bucket_begin(buckets + 1, 0);
+    size_t offset = 0;
+    for (size_t k = 0; k < buckets; k++) {
+        bucket_begin[k] = offset;
+        for (size_t b = 0; b < blocks; b++) {
+            size_t c = counts[b * buckets + k];
+            counts[b * buckets + k] = offset;
+            offset += c;
+        }
+    }
+    bucket_begin[buckets] = n;
+
+    auto buffer = std::make_unique_for_overwrite<T[]>(n);
+    parallelChunks(pool, blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; b++) {
+            size_t* pos = &counts[b * buckets];
+            for (size_t i = blockBegin(b); i < blockBegin(b + 1); i++)
+                buffer[pos[bucketOf(first[i])]++] = std::move(first[i]);
+        }
+    });
+
+    parallelChunks(pool, buckets, 1, [&](size_t lo, size_t hi) {
+        for (size_t k = lo; k < hi; k++) {
+            T* begin = buffer.get() + bucket_begin[k];
+            T* end = buffer.get() + bucket_begin[k + 1];
+            std::sort(begin, end, comp);
+            std::move(begin, end, first + bucket_begin[k]);
+        }
+    });
+}
+
+
+// **************** Task graph ***************
+
+// Declare the work once, run it as many times as needed:
+//   TaskGraph g;
+//   auto a = g.emplace(load), b = g.emplace(parse), c = g.emplace(index);
+//   g.precede(a, b); g.precede(a, c);
+//   g.run(pool);                       // b and c run in parallel once a is done
+// Each run resets per-node counters of unfinished predecessors. A finishing node decrements
+// its successors; those that reach zero are ready. The first ready successor runs right
+// away on the same worker (continuation, no queue round trip), the rest are enqueued
+// together (enqueue_bulk when the pool has it: one lock for a whole fan-out).
+// If a node throws, the rest of the run skips its work and run() rethrows.
+// Don't run the same graph twice at once, and don't call run() from a worker of the same pool.
+
+class TaskGraph {
+public:
+    using NodeId = size_t;
+
+    template <typename F>
+    NodeId emplace(F&& work) {
+        nodes_.push_back(Node{Task(std::forward<F>(work)), {}, 0});
+        validated_ = false;
+        return nodes_.size() - 1;
+    }
+
+    // `before` must finish before `after` starts
+    void precede(NodeId before, NodeId after) {
+        nodes_[before].successors.push_back(after);
+        nodes_[after].predecessors++;
+        validated_ = false;
+    }
+
+    size_t size() const { return nodes_.size(); }
+
+    template <typename Pool>
+    void run(Pool& pool) {
+        if (nodes_.empty()) return;
+        validate();
+
+        // Reuse last run's counters unless a straggler task still holds them
+        if (!state_ || state_.use_count() > 1 || state_->size != nodes_.size())
+            state_ = std::make_shared<RunState>(nodes_.size());
+        for (size_t i = 0; i < nodes_.size(); i++)
+            state_->pending[i].store(nodes_[i].predecessors, std::memory_order_relaxed);
+        state_->remaining.store(nodes_.size(), std::memory_order_relaxed);
+        state_->failed.store(false, std::memory_order_relaxed);
+        state_->error = nullptr;
+
+        for (NodeId root : roots_)
+            dispatch(pool, state_, root);
+
+        size_t left;
+        while ((left = state_->remaining.load(std::memory_order_acquire)) != 0)
+            state_->remaining.wait(left, std::memory_order_acquire);
+
+        if (state_->error)
+            std::rethrow_exception(state_->error);
+    }
+
+private:
+    struct Node {
+        Task work;
+        std::vector<NodeId> successors;
+        size_t predecessors;
+    };
+
+    // Per run. Tasks hold it by shared_ptr so the final notify never touches freed memory.
+    struct RunState {
+        explicit RunState(size_t n) : size(n), pending(std::make_unique<std::atomic<size_t>[]>(n)) {}
+
+        size_t size;
+        std::unique_ptr<std::atomic<size_t>[]> pending;
+        std::atomic<size_t> remaining{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+    };
+
+    // Kahn's algorithm: rejects cycles (they would hang run()) and collects the roots
+    void validate() {
+        if (validated_) return;
+
+        std::vector<size_t> indegree(nodes_.size());
+        std::vector<NodeId> ready;
+        roots_.clear();
+        for (NodeId i = 0; i < nodes_.size(); i++) {
+            indegree[i] = nodes_[i].predecessors;
+            if (indegree[i] == 0) roots_.push_back(i);
+        }
+        ready = roots_;
+
+        size_t visited = 0;
+        while (!ready.empty()) {
+            NodeId id = ready.back();
+            ready.pop_back();
+            visited++;
+            for (NodeId s : nodes_[id].successors)
+                if (--indegree[s] == 0) ready.push_back(s);
+        }
+        if (visited != nodes_.size())
+            throw std::logic_error("TaskGraph has a cycle");
+        validated_ = true;
+    }
+
+    template <typename Pool>
+    Task makeTask(Pool& pool, const std::shared_ptr<RunState>& state, NodeId id) {
+        return Task([this, &pool, state, id] { execute(pool, state, id); });
+    }
+
+    // run() waits for every node, so none of them may be rejected by a bounded pool
+    template <typename Pool>
+    void dispatch(Pool& pool, const std::shared_ptr<RunState>& state, NodeId id) {
+        enqueueContinuation(pool, makeTask(pool, state, id));
+    }
+
+    template <typename Pool>
+    void dispatchAll(Pool& pool, std::vector<Task>& tasks) {
+        if constexpr (requires { pool.enqueue_continuation(tasks); }) {
+            pool.enqueue_continuation(tasks);
+        } else if constexpr (requires { pool.enqueue_bulk(tasks); }) {
+            pool.enqueue_bulk(tasks);
+        } else {
+            for (auto& task : tasks) pool.enqueue(std::move(task));
+        }
+        tasks.clear();
+    }
+
+    template <typename Pool>
+    void execute(Pool& pool, const std::shared_ptr<RunState>& state, NodeId id) {
+        constexpr NodeId kNone = std::numeric_limits<NodeId>::max();
+
+        while (true) {
+            Node& node = nodes_[id];
+            if (!state->failed.load(std::memory_order_relaxed)) {
+                try {
+                    node.work();
+                } catch (...) {
+                    if (!state->failed.exchange(true))
+                        state->error = std::current_exception();
+                }
+            }
+
+            NodeId next = kNone;
+            std::vector<Task> ready;
+            for (NodeId s : node.successors) {
+                if (state->pending[s].fetch_sub(1, std::memory_order_acq_rel) != 1)
+                    continue;
+                if (next == kNone)
+                    next = s;
+                else
+                    ready.push_back(makeTask(pool, state, s));
+            }
+            if (!ready.empty())
+                dispatchAll(pool, ready);
+
+            // After the last decrement run() may return and the graph may be gone:
+            // only the RunState (kept alive by our shared_ptr) is touched from here
+            if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                state->remaining.notify_all();
+            if (next == kNone)
+                return;
+            id = next;
+        }
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<NodeId> roots_;
+    bool validated_ = false;
+    std::shared_ptr<RunState> state_;
+};
+
+// **************** Coroutines ***************
+
+// A handler that waits (sleep, queue pop, timer) used to pin a pool worker for the whole
+// wait. As a coroutine it costs one heap frame instead:
+//   CoTask<void> handle(ThreadPool& pool, CoTimer& timer) {
+//       co_await pool.schedule();          // continue on a pool worker
+//       co_await timer.delay(20ms);        // worker is free while we wait
+//       ...
+//   }
+//   spawn(handle(pool, timer));
+// CoTask<T> is lazy (starts when awaited) and resumes its awaiter by symmetric transfer,
+// so long await chains don't grow the stack. (Task is already the pool's callable.)
+// BoundedBlockingQueue::pop_async() and AlarmCallbackSystem::delay() are awaitable too.
+
+template <typename T>
+class CoTask;
+
+struct CoTaskPromiseBase {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().continuation;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+struct CoTaskPromise : CoTaskPromiseBase {
+    std::optional<T> value;
+
+    CoTask<T> get_return_object();
+
+    template <typename U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+    T result() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct CoTaskPromise<void> : CoTaskPromiseBase {
+    CoTask<void> get_return_object();
+
+    void return_void() {}
+
+    void result() {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+template <typename T = void>
+class CoTask {
+public:
+    using promise_type = CoTaskPromise<T>;
+
+    explicit CoTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    CoTask(CoTask&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(CoTask&&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    ~CoTask() {
+        if (handle_) handle_.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle_.promise().continuation = awaiter;
+        return handle_;
+    }
+
+    T await_resume() { return handle_.promise().result(); }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+CoTask<T> CoTaskPromise<T>::get_return_object() {
+    return CoTask<T>(std::coroutine_handle<CoTaskPromise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> CoTaskPromise<void>::get_return_object() {
+    return CoTask<void>(std::coroutine_handle<CoTaskPromise<void>>::from_promise(*this));
+}
+
+// Fire and forget: runs the CoTask to completion, frees its own frame at the end.
+// An exception escaping the handler terminates, same as one escaping a std::thread.
+struct DetachedCoroutine {
+    struct promise_type {
+        DetachedCoroutine get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+inline DetachedCoroutine spawn(CoTask<void> task) {
+    co_await task;
+}
+
+// Same shape as AlarmCallbackSystem: one thread sleeping until the earliest due time.
+// Due coroutines are resumed on the pool, all the ones due together in one
+// enqueue_continuation. stop() resumes the ones still waiting right away (early) instead
+// of leaking their frames; a delay() after stop() doesn't wait at all.
+class CoTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit CoTimer(ThreadPool& pool) : pool_(pool) {
+        thread_ = std::thread([this] { loop(); });
+    }
+
+    CoTimer(const CoTimer&) = delete;
+    CoTimer& operator=(const CoTimer&) = delete;
+
+    auto delay(Clock::duration d) {
+        struct DelayAwaiter {
+            CoTimer& timer;
+            Clock::duration d;
+
+            bool await_ready() const noexcept { return d <= Clock::duration::zero(); }
+            void await_suspend(std::coroutine_handle<> handle) { timer.add(Clock::now() + d, handle); }
+            void await_resume() const noexcept {}
+        };
+        return DelayAwaiter{*this, d};
+    }
+
+    void stop() {
+        {
+            std::lock_guard lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) thread_.join();
+
+        std::vector<Task> early;
+        {
+            std::lock_guard lock(mtx_);
+            for (; !heap_.empty(); heap_.pop())
+                early.emplace_back([handle = heap_.top().handle] { handle.resume(); });
+        }
+        pool_.enqueue_continuation(early);
+    }
+
+    ~CoTimer() {
+        stop();
+    }
+
+    // Coroutines currently waiting in delay()
+    size_t waiting() {
+        std::lock_guard lock(mtx_);
+        return heap_.size();
+    }
+
+private:
+    struct Entry {
+        Clock::time_point due;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const Entry& other) const { return due > other.due; }
+    };
+
+    void add(Clock::time_point due, std::coroutine_handle<> handle) {
+        bool earliest, stopped;
+        {
+            std::lock_guard lock(mtx_);
+            stopped = stop_;
+            earliest = heap_.empty() || due < heap_.top().due;
+            if (!stopped) heap_.push({due, handle});
+        }
+        if (stopped)
+            pool_.enqueue_continuation(Task([handle] { handle.resume(); }));
+        else if (earliest)
+            cv_.notify_one();               // otherwise the timer thread already wakes up sooner
+    }
+
+    void loop() {
+        std::vector<Task> due;
+        std::unique_lock lock(mtx_);
+        while (!stop_) {
+            if (heap_.empty()) {
+                cv_.wait(lock);
+                continue;
+            }
+            auto now = Clock::now();
+            if (heap_.top().due > now) {
+                auto due = heap_.top().due;     // add() may reallocate the heap while we wait
+                cv_.wait_until(lock, due);
+                continue;
+            }
+            while (!heap_.empty() && heap_.top().due <= now) {
+                due.emplace_back([handle = heap_.top().handle] { handle.resume(); });
+                heap_.pop();
+            }
+            lock.unlock();
+            pool_.enqueue_continuation(due);
+            due.clear();
+            lock.lock();
+        }
+    }
+
+    ThreadPool& pool_;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+// **************** Benchmark ***************
+
+// Sequential STL vs std::execution::par vs the pool versions above, uint32_t inputs.
+// Note: libstdc++ only runs std::execution::par in parallel when built against TBB;
+// without it the "par" column is effectively sequential.
+
+template <typename F>
+double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void benchAlgorithms(int num_threads, size_t max_elements) {
+    ThreadPool pool(num_threads - 1);       // + the calling thread = num_threads
+    auto mix = [](uint64_t x) {
+        x ^= x >> 33; x *= 0xff51afd7ed558ccdULL; x ^= x >> 33;
+        return static_cast<uint32_t>(x);
+    };
+
+    std::cout << "elements      algorithm        seq ms      par ms     pool ms\n";
+    for (size_t n = 1000000; n <= max_elements; n *= 10) {
+        std::vector<uint32_t> data(n), out(n), expected(n);
+        uint32_t* base = data.data();
+        parallel_for(pool, data.begin(), data.end(), [&](uint32_t& x) { x = mix(&x - base); });
+        std::vector<uint32_t> input = data;
+
+        auto row = [&](const char* name, double seq, double par, double ours, bool ok) {
+            std::cout << std::setw(10) << n << "    " << std::setw(16) << std::left << name << std::right
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(10) << seq << std::setw(12) << par << std::setw(12) << ours
+                      << (ok ? "" : "   MISMATCH") << '\n';
+        };
+
+        {
+            auto f = [](uint32_t& x) { x = x * 2 + 1; };
+            double seq = timeMs([&] { std::for_each(data.begin(), data.end(), f); });
+            expected = data;
+            double par = timeMs([&] { std::for_each(std::execution::par, data.begin(), data.end(), f); });
+            data = input;
+            std::for_each(data.begin(), data.end(), f);
+            double ours = timeMs([&] { parallel_for(pool, data.begin(), data.end(), f); });
+            std::for_each(expected.begin(), expected.end(), f);
+            row("for_each", seq, par, ours, data == expected);
+            data = input;
+        }
+        {
+            uint64_t r1 = 0, r2 = 0, r3 = 0;
+            std::plus<uint64_t> add;        // std::plus<> would add pairs of uint32_t and wrap
+            double seq = timeMs([&] { r1 = std::reduce(data.begin(), data.end(), uint64_t(0), add); });
+            double par = timeMs([&] { r2 = std::reduce(std::execution::par, data.begin(), data.end(), uint64_t(0), add); });
+            double ours = timeMs([&] { r3 = parallel_reduce(pool, data.begin(), data.end(), uint64_t(0), add); });
+            row("reduce", seq, par, ours, r1 == r2 && r1 == r3);
+        }
+        {
+            double seq = timeMs([&] { std::inclusive_scan(data.begin(), data.end(), expected.begin()); });
+            double par = timeMs([&] { std::inclusive_scan(std::execution::par, data.begin(), data.end(), out.begin()); });
+            double ours = timeMs([&] { parallel_inclusive_scan(pool, data.begin(), data.end(), out.begin()); });
+            row("inclusive_scan", seq, par, ours, out == expected);
+        }
+        {
+            expected = input;
+            double seq = timeMs([&] { std::sort(expected.begin(), expected.end()); });
+            out = input;
+            double par = timeMs([&] { std::sort(std::execution::par, out.begin(), out.end()); });
+            out = input;
+            double ours = timeMs([&] { parallel_sort(pool, out.begin(), out.end()); });
+            row("sort", seq, par, ours, out == expected);
+        }
+    }
+    pool.stop();
+}
+
+// Latency of sparse high-priority tasks (enqueue → start) while the pool is saturated
+// by a backlog of ~20µs low-priority jobs, for: plain FIFO, the High lane, the deadline lane.
+// Last column: how many Low jobs still ran while a flood of High jobs was queued (starvation check).
+
+inline void spinFor(std::chrono::nanoseconds d) {
+    auto until = std::chrono::steady_clock::now() + d;
+    while (std::chrono::steady_clock::now() < until) {}
+}
+
+void benchPriority(int num_threads) {
+    using namespace std::chrono;
+    constexpr int kSamples = 200;
+    constexpr auto kInterval = milliseconds(1);
+    constexpr auto kLowWork = microseconds(20);
+    const size_t kBacklog = 2 * kSamples * (kInterval / kLowWork) * num_threads;
+
+    std::cout << "mode                  p50 µs      p99 µs      max µs\n";
+    for (int mode = 0; mode < 3; mode++) {
+        ThreadPool pool(num_threads);
+        std::atomic<bool> cancel{false};
+        std::atomic<int> high_done{0};
+        std::vector<double> latency(kSamples);
+
+        pool.enqueue_n(kBacklog, [&](size_t) { if (!cancel) spinFor(kLowWork); },
+                       mode == 0 ? Priority::Normal : Priority::Low);
+
+        for (int i = 0; i < kSamples; i++) {
+            auto t0 = steady_clock::now();
+            Task probe([&, i, t0] {
+                latency[i] = duration<double, std::micro>(steady_clock::now() - t0).count();
+                high_done.fetch_add(1);
+            });
+            if (mode == 0) pool.enqueue(std::move(probe));
+            else if (mode == 1) pool.enqueue(std::move(probe), Priority::High);
+            else pool.enqueue(std::move(probe), t0 + kInterval);
+            std::this_thread::sleep_for(kInterval);
+        }
+        while (high_done.load() < kSamples) std::this_thread::sleep_for(kInterval);
+        cancel = true;
+        pool.stop();
+
+        std::sort(latency.begin(), latency.end());
+        const char* names[] = {"FIFO (all Normal)", "High lane", "Deadline lane (+1ms)"};
+        std::cout << std::setw(20) << std::left << names[mode] << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << latency[kSamples / 2]
+                  << std::setw(12) << latency[kSamples * 99 / 100]
+                  << std::setw(12) << latency.back() << '\n';
+    }
+
+    // Starvation check: flood of High work queued before the Low jobs
+    constexpr size_t kHigh = 20000, kLow = 200, kLimit = 32;
+    ThreadPool pool(num_threads, kLimit);
+    std::atomic<size_t> high_left{kHigh};
+    std::atomic<size_t> low_before_high_done{0};
+    pool.enqueue_n(kHigh, [&](size_t) { spinFor(microseconds(5)); high_left.fetch_sub(1); }, Priority::High);
+    pool.enqueue_n(kLow, [&](size_t) { if (high_left.load() > 0) low_before_high_done.fetch_add(1); }, Priority::Low);
+    pool.stop();
+    std::cout << "starvation limit " << kLimit << ": " << low_before_high_done.load() << "/" << kLow
+              << " Low jobs ran while " << kHigh << " High jobs were still queued\n";
+}
+
+// Elastic pool through two bursts: prints the live worker count every 100ms while a
+// burst of 100µs jobs is drained, then while the pool sits idle and shrinks back to min.
+// The workers started for the second burst reuse the retired workers' metrics slots.
+
+void benchElastic(int max_threads) {
+    using namespace std::chrono;
+    ThreadPoolOptions options;
+    options.min_threads = 2;
+    options.max_threads = max_threads;
+    options.idle_timeout = milliseconds(300);
+    ThreadPool pool(options);
+
+    constexpr long kBurst = 5000;
+    size_t peak = 0;
+    for (int burst = 0; burst < 2; burst++) {
+        std::atomic<long> done{0};
+        pool.enqueue_n(kBurst, [&](size_t) {
+            spinFor(microseconds(100));
+            done.fetch_add(1);
+        });
+
+        auto start = steady_clock::now();
+        std::cout << "   ms  threads  done\n";
+        for (int tick = 0; tick < 100; tick++) {
+            size_t threads = pool.size();
+            long finished = done.load();
+            peak = std::max(peak, threads);
+            std::cout << std::setw(5) << duration_cast<milliseconds>(steady_clock::now() - start).count()
+                      << std::setw(9) << threads << std::setw(6) << finished << '\n';
+            if (finished == kBurst && threads == options.min_threads)
+                break;
+            std::this_thread::sleep_for(milliseconds(100));
+        }
+    }
+#if THREAD_POOL_METRICS
+    std::cout << "worker metrics slots: " << pool.metrics().workers.size() << " (peak live workers " << peak << ")\n";
+#endif
+    pool.stop();
+}
+
+// Local vs remote: a buffer first-touched on node 0, tasks that each sum a 64KB slice of it,
+// sent to node 0's workers (local) or node 1's workers (remote), cross-node stealing off.
+// With a single node the CPUs are split in two groups, which only shows the pinning cost.
+
+void benchNuma() {
+    NumaTopology topology = NumaTopology::detect();
+    for (size_t n = 0; n < topology.node_cpus.size(); n++)
+        std::cout << "node " << n << ": " << topology.node_cpus[n].size() << " cpus\n";
+
+    if (topology.node_cpus.size() < 2) {
+        std::vector<int> all = topology.node_cpus[0];
+        if (all.size() < 2) {
+            std::cout << "need at least 2 cpus\n";
+            return;
+        }
+        topology.node_cpus = {std::vector<int>(all.begin(), all.begin() + all.size() / 2),
+                              std::vector<int>(all.begin() + all.size() / 2, all.end())};
+        std::cout << "single NUMA node: using two halves of the CPUs as fake nodes\n";
+    }
+
+    constexpr size_t kWords = size_t(128) << 20 >> 3;   // 128MB
+    constexpr size_t kSlice = 8192;                      // 64KB per task
+    constexpr size_t kTasks = 16 * kWords / kSlice;      // every slice read 16 times
+
+    std::unique_ptr<uint64_t[]> buffer;
+    std::thread toucher([&] {
+        pinThisThread(topology.node_cpus[0][0]);
+        buffer = std::make_unique_for_overwrite<uint64_t[]>(kWords);
+        for (size_t i = 0; i < kWords; i++) buffer[i] = i;
+    });
+    toucher.join();
+
+    WorkStealingThreadPool pool(topology, /*cross_node_steal=*/false);
+    std::atomic<uint64_t> sink{0};
+
+    for (size_t target : {size_t(0), size_t(1)}) {
+        std::atomic<long> done{0};
+        auto start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < kTasks; t++) {
+            pool.enqueue(Task([&, t] {
+                const uint64_t* p = buffer.get() + (t * kSlice) % kWords;
+                uint64_t sum = 0;
+                for (size_t i = 0; i < kSlice; i++) sum += p[i];
+                sink.fetch_add(sum, std::memory_order_relaxed);
+                done.fetch_add(1, std::memory_order_release);
+            }), target);
+        }
+        waitFor(done, kTasks);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << (target == 0 ? "local  (node 0 workers): " : "remote (node 1 workers): ")
+                  << std::fixed << std::setprecision(0) << kTasks / secs << " tasks/s, "
+                  << std::setprecision(2) << kTasks * kSlice * 8 / secs / 1e9 << " GB/s\n";
+    }
+    pool.stop();
+}
+
+// Bursty traffic: bursts of 8 tiny tasks every 200µs. Per idle policy: enqueue→start
+// latency and CPU burned (process CPU time / wall time, in cores).
+
+void benchIdle(int num_threads) {
+    using namespace std::chrono;
+    struct Case { const char* name; IdlePolicy policy; };
+    const Case cases[] = {
+        {"park", {0, 0}},
+        {"yield 64 -> park", {0, 64}},
+        {"spin 2k -> yield 64 -> park", {2000, 64}},
+        {"spin 50k -> park", {50000, 0}},
+    };
+    constexpr int kBursts = 2000, kBurstSize = 8;
+
+    std::cout << "policy                        p50 µs    p99 µs   cpu cores\n";
+    for (const Case& c : cases) {
+        ThreadPoolOptions options;
+        options.min_threads = options.max_threads = num_threads;
+        options.idle = c.policy;
+        ThreadPool pool(options);
+
+        std::vector<double> latency(kBursts * kBurstSize);
+        std::atomic<long> done{0};
+
+        std::clock_t cpu_start = std::clock();
+        auto wall_start = steady_clock::now();
+        for (int b = 0; b < kBursts; b++) {
+            for (int k = 0; k < kBurstSize; k++) {
+                auto t0 = steady_clock::now();
+                int slot = b * kBurstSize + k;
+                pool.enqueue(Task([&, slot, t0] {
+                    latency[slot] = duration<double, std::micro>(steady_clock::now() - t0).count();
+                    done.fetch_add(1, std::memory_order_release);
+                }));
+            }
+            std::this_thread::sleep_for(microseconds(200));
+        }
+        waitFor(done, kBursts * kBurstSize);
+        double wall = duration<double>(steady_clock::now() - wall_start).count();
+        double cpu = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        pool.stop();
+
+        std::sort(latency.begin(), latency.end());
+        std::cout << std::setw(28) << std::left << c.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(9) << latency[latency.size() / 2]
+                  << std::setw(10) << latency[latency.size() * 99 / 100]
+                  << std::setw(12) << std::setprecision(2) << cpu / wall << '\n';
+    }
+}
+
+// Scheduling overhead per node (empty work) for a wide graph (source → N → sink) and a
+// deep one (chain of N). First run includes validation; re-runs reuse the built graph.
+
+void benchGraph(int num_threads) {
+    constexpr size_t kNodes = 100000;
+    constexpr int kRuns = 5;
+    ThreadPool pool(num_threads);
+    std::atomic<size_t> executed{0};
+    auto work = [&executed] { executed.fetch_add(1, std::memory_order_relaxed); };
+
+    TaskGraph wide;
+    auto source = wide.emplace(work);
+    auto sink = wide.emplace(work);
+    for (size_t i = 0; i < kNodes; i++) {
+        auto mid = wide.emplace(work);
+        wide.precede(source, mid);
+        wide.precede(mid, sink);
+    }
+
+    TaskGraph deep;
+    auto prev = deep.emplace(work);
+    for (size_t i = 1; i < kNodes; i++) {
+        auto next = deep.emplace(work);
+        deep.precede(prev, next);
+        prev = next;
+    }
+
+    std::cout << "graph    nodes    first run ns/node   re-run ns/node\n";
+    for (auto [name, graph] : {std::pair{"wide", &wide}, std::pair{"deep", &deep}}) {
+        executed = 0;
+        double first = timeMs([&] { graph->run(pool); }) * 1e6 / graph->size();
+        double rerun = timeMs([&] { for (int r = 0; r < kRuns; r++) graph->run(pool); }) * 1e6 / (kRuns * graph->size());
+        std::cout << std::setw(5) << name << std::setw(9) << graph->size()
+                  << std::fixed << std::setprecision(1) << std::setw(18) << first << std::setw(17) << rerun
+                  << (executed == (kRuns + 1) * graph->size() ? "" : "   WRONG COUNT") << '\n';
+    }
+    pool.stop();
+}
+
+// 100k handlers that each wait 20ms then do a little work:
+//  - coroutines: co_await timer.delay() on a pool of `threads` workers
+//  - blocking:   the same pool, every handler sleeps on its worker (sampled, then projected)
+//  - std::thread per handler (capped at 2000, each also reserves a full stack)
+
+CoTask<void> sleepyHandler(ThreadPool& pool, CoTimer& timer, std::atomic<long>& done,
+                           std::chrono::milliseconds wait) {
+    co_await pool.schedule();
+    co_await timer.delay(wait);
+    tinyWork();
+    done.fetch_add(1, std::memory_order_release);
+}
+
+void benchCoroutines(int num_threads, long handlers) {
+    using namespace std::chrono;
+    constexpr auto kWait = milliseconds(20);
+
+    auto row = [&](const char* name, long n, double ms, double bytes) {
+        std::cout << std::setw(30) << std::left << name << std::right << std::setw(9) << n
+                  << std::fixed << std::setprecision(0) << std::setw(11) << ms
+                  << std::setw(13) << n / (ms / 1000) << std::setw(12);
+        if (bytes >= 0) std::cout << bytes; else std::cout << "-";
+        std::cout << '\n';
+    };
+
+    std::cout << "approach                       handlers    wall ms   handlers/s  heap B/each\n";
+    {
+        ThreadPool pool(num_threads);
+        CoTimer timer(pool);
+        std::atomic<long> done{0};
+
+        long bytes_before = g_allocation_bytes.load();
+        auto start = steady_clock::now();
+        for (long i = 0; i < handlers; i++)
+            spawn(sleepyHandler(pool, timer, done, kWait));
+        double bytes = double(g_allocation_bytes.load() - bytes_before) / handlers;    // frames are all alive here
+        waitFor(done, handlers);
+        row("coroutines (co_await delay)", handlers, duration<double, std::milli>(steady_clock::now() - start).count(), bytes);
+        timer.stop();
+        pool.stop();
+    }
+    {
+        long sample = std::min<long>(handlers, num_threads * (seconds(1) / kWait));
+        ThreadPool pool(num_threads);
+        std::atomic<long> done{0};
+        auto start = steady_clock::now();
+        pool.enqueue_n(sample, [&](size_t) {
+            std::this_thread::sleep_for(kWait);
+            tinyWork();
+            done.fetch_add(1, std::memory_order_release);
+        });
+        waitFor(done, sample);
+        double ms = duration<double, std::milli>(steady_clock::now() - start).count();
+        row("blocking pool workers", handlers, ms * handlers / sample, -1);
+        pool.stop();
+    }
+    {
+        long n = std::min<long>(handlers, 2000);
+        std::atomic<long> done{0};
+        std::vector<std::thread> threads;
+        threads.reserve(n);
+        auto start = steady_clock::now();
+        try {
+            for (long i = 0; i < n; i++) {
+                threads.emplace_back([&] {
+                    std::this_thread::sleep_for(kWait);
+                    tinyWork();
+                    done.fetch_add(1, std::memory_order_release);
+                });
+            }
+        } catch (const std::system_error& e) {
+            std::cout << "thread creation failed after " << threads.size() << ": " << e.what() << '\n';
+        }
+        for (auto& t : threads) t.join();
+        row("std::thread per handler", long(threads.size()),
+            duration<double, std::milli>(steady_clock::now() - start).count(), -1);
+    }
+}
+
+// Delays added from 4 threads at once while the timer thread sleeps until the earliest:
+// the heap grows (and reallocates) under it the whole time. Every handler must resume.
+void checkTimerChurn(int num_threads, long handlers) {
+    using namespace std::chrono;
+    constexpr int kAdders = 4;
+    ThreadPool pool(num_threads);
+    CoTimer timer(pool);
+    std::atomic<long> done{0};
+    auto start = steady_clock::now();
+    std::vector<std::thread> adders;
+    for (int t = 0; t < kAdders; t++) {
+        adders.emplace_back([&, t] {
+            std::mt19937 rng(t);
+            for (long i = t; i < handlers; i += kAdders)
+                spawn(sleepyHandler(pool, timer, done, milliseconds(1 + rng() % 20)));
+        });
+    }
+    for (auto& t : adders) t.join();
+    waitFor(done, handlers);
+    std::cout << "timer churn: " << handlers << " delays added from " << kAdders << " threads, all resumed in "
+              << std::fixed << std::setprecision(0) << duration<double, std::milli>(steady_clock::now() - start).count()
+              << " ms\n";
+
+    // Still sleeping at stop(): resumed early, not leaked
+    constexpr long kSleepers = 1000;
+    for (long i = 0; i < kSleepers; i++)
+        spawn(sleepyHandler(pool, timer, done, hours(1)));
+    while (timer.waiting() < kSleepers) std::this_thread::sleep_for(milliseconds(1));
+    timer.stop();
+    waitFor(done, handlers + kSleepers);
+    std::cout << "timer stop() with " << kSleepers << " sleepers: all resumed\n";
+    pool.stop();
+}
+
+// Cost of the metrics hooks, then a snapshot of a saturated pool.
+// Build once more with -DTHREAD_POOL_METRICS=0 to compare the end-to-end ns/task.
+//  - hooks: what one task pays (enqueue stamp + depth update + start/finish on the worker),
+//    single thread, nothing contended
+//  - end to end: 1M empty tasks through enqueue() on `threads` workers
+
+void benchMetrics(int num_threads) {
+    using namespace std::chrono;
+    constexpr long kIterations = 10000000;
+    constexpr long kTasks = 1000000;
+
+    {
+        SubmitMetrics submit;
+        WorkerMetrics worker;
+        double ms = timeMs([&] {
+            for (long i = 0; i < kIterations; i++) {
+                TaskStamp stamp = submit.stamp();
+                submit.pushed(1, i & 63);
+                worker.taskFinished(worker.taskStarted(stamp));
+            }
+        });
+        std::cout << "metrics hooks:  " << std::fixed << std::setprecision(1)
+                  << ms * 1e6 / kIterations << " ns/task"
+                  << (THREAD_POOL_METRICS ? "" : " (compiled out)") << '\n';
+    }
+    {
+        ThreadPool pool(num_threads);
+        std::atomic<long> done{0};
+        double ms = timeMs([&] {
+            for (long i = 0; i < kTasks; i++)
+                pool.enqueue(Task([&done] { done.fetch_add(1, std::memory_order_relaxed); }));
+            waitFor(done, kTasks);
+        });
+        std::cout << "end to end:     " << ms * 1e6 / kTasks << " ns/task\n\n";
+    }
+
+    // Saturated: 4x as many submitters as workers, 1% of tasks 100x longer
+    ThreadPool pool(num_threads);
+    std::atomic<long> done{0};
+    constexpr long kPerSubmitter = 20000;
+    std::vector<std::thread> submitters;
+    for (int s = 0; s < num_threads * 4; s++) {
+        submitters.emplace_back([&pool, &done, s] {
+            for (long i = 0; i < kPerSubmitter; i++) {
+                auto work = (i + s) % 100 == 0 ? microseconds(100) : microseconds(1);
+                pool.enqueue(Task([&done, work] {
+                    spinFor(work);
+                    done.fetch_add(1, std::memory_order_relaxed);
+                }));
+            }
+        });
+    }
+    for (auto& t : submitters) t.join();
+    waitFor(done, num_threads * 4 * kPerSubmitter);
+    pool.metrics().print(std::cout);
+    pool.stop();
+}
+
+// Recording rate (every thread hammering its own ring), then a labelled workload
+// dumped to thread_pool_trace.json for chrome://tracing / ui.perfetto.dev.
+
+void benchTracing(int num_threads) {
+    constexpr long kEvents = 3000000;       // per thread, as begin/end pairs
+
+    if (!THREAD_POOL_TRACING) {
+        std::cout << "tracing compiled out (THREAD_POOL_TRACING=0)\n";
+        return;
+    }
+
+    TaskTracer::start();
+    for (int threads = 1; threads <= num_threads; threads *= 2) {
+        std::vector<std::thread> recorders;
+        double ms = timeMs([&] {
+            for (int t = 0; t < threads; t++) {
+                recorders.emplace_back([] {
+                    TaskStamp stamp;
+                    TaskTracer::enqueued(stamp, "bench");
+                    for (long i = 0; i < kEvents / 2; i++) {
+                        TaskTracer::begin(stamp);
+                        TaskTracer::end(stamp);
+                    }
+                });
+            }
+            for (auto& t : recorders) t.join();
+        });
+        std::cout << std::setw(2) << threads << " threads: " << std::fixed << std::setprecision(1)
+                  << threads * kEvents / ms / 1000 << "M events/s\n";
+    }
+
+    // Fresh start so the dump only holds the workload below
+    TaskTracer::start();
+    {
+        ThreadPool pool(num_threads);
+        std::atomic<long> done{0};
+        const char* labels[] = {"parse", "hash", "compress"};
+        for (long i = 0; i < 3000; i++) {
+            long work = 1 + i % 3 * 10;
+            pool.enqueue(Task([&done, work] {
+                spinFor(std::chrono::microseconds(work));
+                done.fetch_add(1, std::memory_order_relaxed);
+            }), labels[i % 3], i % 50 == 0 ? Priority::High : Priority::Normal);
+        }
+        waitFor(done, 3000);
+        pool.stop();
+    }
+    TaskTracer::stop();
+    std::ofstream file("thread_pool_trace.json");
+    size_t events = TaskTracer::dump(file);
+    std::cout << events << " events written to thread_pool_trace.json\n";
+}
+
+// Per-key ordering for 1M keys with Zipf(1) popularity (key k posted ∝ 1/k; the
+// hottest key gets ~7% of all posts):
+//  - strands:      pool.strand(key).post(fn)
+//  - mutex inside: pool.enqueue(fn) where fn locks one of 64k striped mutexes for its key,
+//                  the way it was done before. Exclusive, but not FIFO per key, and a
+//                  worker that finds the hot key locked just sits there ("blocked ms",
+//                  summed over workers).
+// Every task checks it is the next one for its key; "out of order" counts those that weren't.
+// On one core the stripe locks are never contended, so only the strand bookkeeping shows.
+
+void benchStrands(int num_threads, size_t keys) {
+    constexpr long kPosts = 2000000;
+    constexpr size_t kStripes = 65536;
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<uint32_t> sequence(kPosts);
+    std::vector<uint32_t> key_of(kPosts);
+    {
+        std::vector<uint32_t> next(keys, 0);
+        double log_keys = std::log(double(keys));
+        for (long i = 0; i < kPosts; i++) {
+            auto k = std::min<size_t>(size_t(std::exp(uniform(rng) * log_keys)) - 1, keys - 1);
+            key_of[i] = uint32_t(k);
+            sequence[i] = next[k]++;
+        }
+        std::cout << keys << " keys, " << kPosts << " posts, hottest key " << std::fixed << std::setprecision(1)
+                  << 100.0 * next[0] / kPosts << "% of them\n";
+    }
+
+    std::cout << "approach           ms    Mtasks/s   out of order   blocked ms\n";
+    for (int variant = 0; variant < 2; variant++) {
+        ThreadPool pool(num_threads);
+        std::vector<uint32_t> seen(keys, 0);       // guarded by the key's strand / stripe
+        std::vector<std::mutex> stripes(variant == 1 ? kStripes : 0);
+        std::atomic<long> done{0}, out_of_order{0}, blocked_ns{0};
+
+        double ms = timeMs([&] {
+            for (long i = 0; i < kPosts; i++) {
+                uint32_t k = key_of[i], seq = sequence[i];
+                auto body = [&seen, &out_of_order, &done, k, seq] {
+                    tinyWork();
+                    if (seen[k]++ != seq) out_of_order.fetch_add(1, std::memory_order_relaxed);
+                    done.fetch_add(1, std::memory_order_release);
+                };
+                if (variant == 0) {
+                    pool.strand(k).post(body);
+                } else {
+                    pool.enqueue(Task([&stripes, &blocked_ns, body, k]() mutable {
+                        std::unique_lock lock(stripes[k % kStripes], std::try_to_lock);
+                        if (!lock) {
+                            auto start = std::chrono::steady_clock::now();
+                            lock.lock();
+                            blocked_ns.fetch_add((std::chrono::steady_clock::now() - start).count());
+                        }
+                        body();
+                    }));
+                }
+            }
+            waitFor(done, kPosts);
+        });
+        std::cout << std::setw(14) << std::left << (variant == 0 ? "strands" : "mutex inside") << std::right
+                  << std::setw(8) << std::setprecision(0) << ms << std::setw(12) << std::setprecision(2)
+                  << kPosts / ms / 1000 << std::setw(15) << out_of_order.load()
+                  << std::setw(13) << std::setprecision(1) << blocked_ns.load() / 1e6 << '\n';
+        pool.stop();
+    }
+}
+
+// stop() while one strand still has a backlog: the only worker is held until stop() is
+// waiting for it, then every queued post must still run, and so must one posted after.
+void checkStrandStop() {
+    constexpr int kPosts = 100;
+    ThreadPool pool(1);
+    std::atomic<bool> release{false};
+    std::atomic<int> ran{0};
+    pool.enqueue(Task([&release] {
+        while (!release.load()) std::this_thread::yield();
+    }));
+    for (int i = 0; i < kPosts; i++)
+        pool.strand(0).post(Task([&ran] { ran.fetch_add(1); }));
+
+    std::thread stopper([&pool] { pool.stop(); });
+    while (!pool.stopping()) std::this_thread::yield();
+    release = true;
+    stopper.join();
+    int backlog = ran.load();
+    pool.strand(0).post(Task([&ran] { ran.fetch_add(1); }));
+    std::cout << "stop() with a " << kPosts << "-task strand backlog: " << backlog << '/' << kPosts
+              << " ran, post after stop() " << (ran.load() == kPosts + 1 ? "ran" : "lost") << '\n';
+}
+
+// DropOldest must only shed plain enqueue()s: 1 worker held busy, max_queue 4, a strand
+// post and a TaskGraph's root queued, then 64 enqueues. A dropped strand drain would
+// leave its key stuck forever, a dropped graph node would hang run().
+
+void checkDropOldestContinuations() {
+    using namespace std::chrono;
+    constexpr int kPosts = 8, kNodes = 8, kFlood = 64;
+    ThreadPoolOptions options;
+    options.max_queue = 4;
+    options.overflow = OverflowPolicy::DropOldest;
+    ThreadPool pool(options);
+
+    std::atomic<bool> busy{false}, release{false};
+    std::atomic<int> strand_ran{0}, nodes_ran{0};
+    pool.enqueue(Task([&busy, &release] {
+        busy = true;
+        release.wait(false);            // parked, not spinning: the runner thread needs the CPU
+    }));
+    while (!busy.load()) std::this_thread::sleep_for(milliseconds(1));
+    pool.strand(1).post(Task([&strand_ran] { strand_ran.fetch_add(1); }));
+
+    TaskGraph graph;
+    for (int i = 0; i < kNodes; i++) {
+        auto id = graph.emplace([&nodes_ran] { nodes_ran.fetch_add(1); });
+        if (i > 0) graph.precede(id - 1, id);
+    }
+    std::thread runner([&] { graph.run(pool); });
+    while (pool.queue_size() < 2) std::this_thread::sleep_for(milliseconds(1));
+
+    for (int i = 0; i < kFlood; i++) pool.enqueue(Task([] {}));
+    release = true;
+    release.notify_one();
+    for (int i = 1; i < kPosts; i++)
+        pool.strand(1).post(Task([&strand_ran] { strand_ran.fetch_add(1); }));
+    runner.join();
+    auto deadline = steady_clock::now() + seconds(2);
+    while (strand_ran.load() < kPosts && steady_clock::now() < deadline) std::this_thread::sleep_for(milliseconds(1));
+
+    std::cout << "\nDropOldest, max_queue 4: strand ran " << strand_ran.load() << " of " << kPosts
+              << ", graph ran " << nodes_ran.load() << " of " << kNodes << " nodes, "
+              << pool.overflow_counts().dropped_oldest << " plain tasks dropped\n";
+    pool.stop();
+}
+
+// 2x sustained overload: one submitter paced at twice what the pool can run, for 1s,
+// once unbounded and once per OverflowPolicy with max_queue = 1024.
+//  - done/s:   tasks completed per second during the overload window
+//  - peak queue / MB: deepest the queue got and what its slots held (Task + stamp)
+//  - then what happened to everything submitted (OverflowCounts)
+// Unbounded just grows; Block and CallerRuns slow the submitter to the pool's pace;
+// Reject and DropOldest keep it at 2x and shed the excess.
+
+void benchOverload(int num_threads) {
+    using namespace std::chrono;
+    static constexpr auto kWork = microseconds(20);
+    constexpr auto kWindow = milliseconds(1000);
+    constexpr size_t kMaxQueue = 1024;
+
+    auto work = [](std::atomic<long>& done) {
+        return Task([&done] {
+            spinFor(kWork);
+            done.fetch_add(1, std::memory_order_relaxed);
+        });
+    };
+
+    double service_per_ms;
+    {
+        ThreadPool pool(num_threads);
+        std::atomic<long> done{0};
+        std::atomic<bool> measured{false};
+        pool.enqueue_n(1000000, [&](size_t) {
+            if (measured) return;
+            spinFor(kWork);
+            done.fetch_add(1, std::memory_order_relaxed);
+        });
+        std::this_thread::sleep_for(milliseconds(300));
+        service_per_ms = done.load() / 300.0;
+        measured = true;
+        pool.stop();
+    }
+    std::cout << "pool runs " << std::fixed << std::setprecision(0) << service_per_ms * 1000
+              << " tasks/s, submitting " << 2 * service_per_ms * 1000 << "/s\n\n";
+
+    std::cout << "policy         done/s  peak queue  queue MB |    queued   blocked  in caller  rejected   dropped\n";
+    const char* names[] = {"unbounded", "Block", "CallerRuns", "Reject", "DropOldest"};
+    OverflowPolicy policies[] = {OverflowPolicy::Block, OverflowPolicy::Block, OverflowPolicy::CallerRuns,
+                                 OverflowPolicy::Reject, OverflowPolicy::DropOldest};
+    for (int p = 0; p < 5; p++) {
+        ThreadPoolOptions options;
+        options.min_threads = options.max_threads = num_threads;
+        options.max_queue = p == 0 ? 0 : kMaxQueue;
+        options.overflow = policies[p];
+        ThreadPool pool(options);
+        std::atomic<long> done{0};
+        size_t peak = 0;
+
+        auto start = steady_clock::now();
+        long submitted = 0;
+        while (true) {
+            auto elapsed = steady_clock::now() - start;
+            if (elapsed >= kWindow) break;
+            long target = long(duration<double, std::milli>(elapsed).count() * 2 * service_per_ms);
+            for (; submitted < target; submitted++) pool.enqueue(work(done));
+            peak = std::max(peak, pool.queue_size());
+            std::this_thread::yield();
+        }
+        long completed = done.load();
+        OverflowCounts counts = pool.overflow_counts();
+        double mb = peak * (sizeof(Task) + sizeof(TaskStamp)) / 1e6;
+
+        std::cout << std::setw(12) << std::left << names[p] << std::right << std::setw(9) << completed * 1000.0 / kWindow.count()
+                  << std::setw(12) << peak << std::setw(10) << std::setprecision(2) << mb << " |"
+                  << std::setw(10) << counts.queued << std::setw(10) << counts.blocked << std::setw(11) << counts.ran_in_caller
+                  << std::setw(10) << counts.rejected << std::setw(10) << counts.dropped_oldest << '\n'
+                  << std::setprecision(0);
+        pool.stop();
+    }
+    checkDropOldestContinuations();
+}
+
+void printFunc(int counter){
+    std::cout << " Printing Function : " << counter << std::endl;
+}
+
+// g++ -std=c++20 -O2 -pthread thread_pool.cpp -ltbb      (TBB backs std::execution::par)
+//   ./a.out                 → demo
+//   ./a.out steal [threads] → single-queue vs work-stealing throughput, 1..threads (default 64)
+//   ./a.out task [threads]  → allocations and ns per task, std::function vs Task
+//   ./a.out bulk [threads]  → submit cost per task for batch sizes 1, 64, 10k
+//   ./a.out algo [threads] [max elements] → parallel_for/reduce/inclusive_scan/sort vs STL, 1M..max (default 1B)
+//   ./a.out prio [threads]  → p99 latency of high-priority tasks in a saturated pool
+//   ./a.out elastic [max]   → live worker count of an elastic pool (2..max) through a burst
+//   ./a.out numa            → node-local vs remote task throughput on pinned worker groups
+//   ./a.out idle [threads]  → wakeup latency and CPU burn per idle policy (spin/yield/park)
+//   ./a.out graph [threads] → TaskGraph scheduling overhead per node, wide and deep graphs
+//   ./a.out coro [threads] [handlers] → 100k waiting handlers: coroutines vs blocked threads
+//                                     then timers added from 4 threads while the timer sleeps,
+//                                     and stop() with 1000 coroutines still waiting
+//   ./a.out metrics [threads] → cost of the metrics hooks, snapshot of a saturated pool
+//                               (-DTHREAD_POOL_METRICS=0 compiles the metrics out)
+//   ./a.out trace [threads] → tracer recording rate, writes thread_pool_trace.json
+//                             (-DTHREAD_POOL_TRACING=0 compiles the tracer out)
+//   ./a.out strand [threads] [keys] → per-key ordering, 1M Zipf keys: strands vs a mutex inside the task,
+//                                     then stop() with a strand backlog
+//   ./a.out overload [threads] → throughput, queue memory and decisions per OverflowPolicy at 2x load,
+//                              then DropOldest with a strand and a TaskGraph in flight
+int main(int argc, char* argv[]){
+
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    if(mode == "steal"){
+        benchWorkStealing(argc > 2 ? std::stoi(argv[2]) : 64);
+        return 0;
+    }
+
+    if(mode == "task"){
+        benchTask(argc > 2 ? std::stoi(argv[2]) : 4);
+        return 0;
+    }
+
+    if(mode == "bulk"){
+        benchBulk(argc > 2 ? std::stoi(argv[2]) : 4);
+        return 0;
+    }
+
+    if(mode == "algo"){
+        benchAlgorithms(argc > 2 ? std::stoi(argv[2]) : std::thread::hardware_concurrency(),
+                        argc > 3 ? std::stoull(argv[3]) : 1000000000ULL);
+        return 0;
+    }
+
+    if(mode == "prio"){
+        benchPriority(argc > 2 ? std::stoi(argv[2]) : 4);
+        return 0;
+    }
+
+    if(mode == "elastic"){
+        benchElastic(argc > 2 ? std::stoi(argv[2]) : 16);
+        return 0;
+    }
+
+    if(mode == "numa"){
+        benchNuma();
+        return 0;
+    }
+
+    if(mode == "idle"){
+        benchIdle(argc > 2 ? std::stoi(argv[2]) : 4);
+        return 0;
+    }
+
+    if(mode == "graph"){
+        benchGraph(argc > 2 ? std::stoi(argv[2]) : 4);
+        return 0;
+    }
+
+    if(mode == "coro"){
+        int threads = argc > 2 ? std::stoi(argv[2]) : 4;
+        long handlers = argc > 3 ? std::stol(argv[3]) : 100000;
+        benchCoroutines(threads, handlers);
+        checkTimerChurn(threads, handlers);
+        return 0;
+    }
+
+    if(mode == "metrics"){
+        benchMetrics(argc > 2 ? std::stoi(argv[2]) : 4);
+        return 0;
+    }
+
+    if(mode == "trace"){
+        benchTracing(argc > 2 ? std::stoi(argv[2]) : 4);
+        return 0;
+    }
+
+    if(mode == "strand"){
+        benchStrands(argc > 2 ? std::stoi(argv[2]) : 4, argc > 3 ? std::stoull(argv[3]) : 1000000);
+        checkStrandStop();
+        return 0;
+    }
+
+    if(mode == "overload"){
+        benchOverload(argc > 2 ? std::stoi(argv[2]) : 4);
+        return 0;
+    }
 
     ThreadPool pool(10);
 